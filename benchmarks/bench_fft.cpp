@@ -0,0 +1,90 @@
+#include <gaussianblur/gaussianblur.h>
+
+#include <chrono>
+#include <functional>
+
+// Average wall time of `iterations` runs of `run`, in ms
+double time_ms(const int iterations, const std::function<void()>& run) {
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) run();
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+             .count() /
+         iterations;
+}
+
+// Round trips of rows of a valid size of the backend, in us per row
+double bench_transform(const gaussianblur::FftBackend& backend, const int size,
+                       const int iterations) {
+  const std::unique_ptr<gaussianblur::FftSetup> setup = backend.setup(size);
+  const int batch = setup->layout().batch;
+  AlignedVector<float> signal((size_t)size * batch), spectrum(signal.size()),
+      work(signal.size());
+  for (size_t i = 0; i < signal.size(); ++i) signal[i] = (float)(i % 251);
+  return time_ms(iterations,
+                 [&]() {
+                   setup->forward(signal.data(), spectrum.data(),
+                                  work.data());
+                   setup->backward(spectrum.data(), signal.data(),
+                                   work.data());
+                 }) *
+         1000 / batch;
+}
+
+// Blurs an RGB image through the backend
+double bench_blur(const gaussianblur::FftBackend& backend, const int rows,
+                  const int cols, const float sigma, const int iterations) {
+  std::vector<uint8_t> image_data((size_t)rows * cols * 3);
+  for (size_t i = 0; i < image_data.size(); ++i) image_data[i] = i % 253;
+  gaussianblur::BlurOptions options;
+  options.fft_backend = &backend;
+  return time_ms(iterations, [&]() {
+    Image image = {image_data, ImgGeom{rows, cols, 3}};
+    gaussianblur::gaussianblur(image, sigma, options);
+  });
+}
+
+void print_help() {
+  std::cout << "Usage: bench_fft [rows] [cols] [sigma] [iterations]\n";
+  std::cout << "  Times the FFT round trip of each backend at the tile sizes "
+               "of the image and a whole RGB blur through each backend.\n";
+  std::cout << "  Defaults to a 4K frame (2160 x 3840), sigma 5 and 5 "
+               "iterations, a single row (e.g. 1 x 1000000) shows the "
+               "four-step FFT of long rows.\n";
+}
+
+int main(int argc, char* argv[]) {
+  if (argc == 2 &&
+      (std::string(argv[1]) == "--help" || std::string(argv[1]) == "-h")) {
+    print_help();
+    return 0;
+  }
+
+  const int rows = argc > 1 ? std::stoi(argv[1]) : 2160;
+  const int cols = argc > 2 ? std::stoi(argv[2]) : 3840;
+  const float sigma = argc > 3 ? std::stof(argv[3]) : 5.0F;
+  const int iterations = argc > 4 ? std::stoi(argv[4]) : 5;
+  if (rows <= 0 || cols <= 0 || sigma <= 0 || iterations <= 0) {
+    print_help();
+    return 1;
+  }
+  printf("Image %dx%d RGB, sigma %.1f, %d iterations, %s kernels\n", cols,
+         rows, sigma, iterations,
+         gaussianblur::isa_name(gaussianblur::kernels().level));
+
+  // the tiles are padded by about 3 sigma on each side
+  const int pad = (int)(3 * sigma);
+  for (const gaussianblur::FftBackend* backend :
+       {&gaussianblur::pffft_backend(), &gaussianblur::batched_fft_backend(),
+        &gaussianblur::four_step_fft_backend()}) {
+    const int row_size = backend->nearest_valid_size(cols + 2 * pad);
+    const int col_size = backend->nearest_valid_size(rows + 2 * pad);
+    printf("%-9s row FFT %6d: %8.2f us/row  col FFT %6d: %8.2f us/row  "
+           "blur %9.2f ms\n",
+           backend->name(), row_size,
+           bench_transform(*backend, row_size, iterations * 100), col_size,
+           bench_transform(*backend, col_size, iterations * 100),
+           bench_blur(*backend, rows, cols, sigma, iterations));
+  }
+  return 0;
+}
@@ -0,0 +1,74 @@
+#include <gaussianblur/gaussianblur.h>
+
+#include <chrono>
+#include <functional>
+
+// Average wall time of `iterations` runs of `run`, in ms
+double time_ms(const int iterations, const std::function<void()>& run) {
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) run();
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+             .count() /
+         iterations;
+}
+
+// Transposes a plane twice (rows -> cols -> rows), the access pattern of the
+// transposes between the row and the column pass
+double bench_transpose(const int rows, const int cols, const int iterations) {
+  AlignedVector<float> plane(rows * cols), transposed(rows * cols);
+  for (size_t i = 0; i < plane.size(); ++i) plane[i] = (float)(i % 251);
+  return time_ms(iterations, [&]() {
+    flip_block<1>(plane.data(), transposed.data(), cols, rows);
+    flip_block<1>(transposed.data(), plane.data(), rows, cols);
+  });
+}
+
+// Blurs a gray image: row pass, transpose, column pass, transpose back
+double bench_blur(const int rows, const int cols, const float sigma,
+                  const int iterations) {
+  std::vector<uint8_t> image_data(rows * cols);
+  for (size_t i = 0; i < image_data.size(); ++i) image_data[i] = i % 253;
+  return time_ms(iterations, [&]() {
+    Image image = {image_data, ImgGeom{rows, cols, 1}};
+    gaussianblur::gaussianblur(image, sigma, false);
+  });
+}
+
+void print_help() {
+  std::cout << "Usage: bench_hugepages [rows] [cols] [sigma] [iterations]\n";
+  std::cout << "  Times the plane transposes and a whole gray blur with the "
+               "float planes on regular pages and on 2 MB pages.\n";
+  std::cout << "  Defaults to a 8K frame (4320 x 7680), sigma 5 and 5 "
+               "iterations.\n";
+}
+
+int main(int argc, char* argv[]) {
+  if (argc == 2 &&
+      (std::string(argv[1]) == "--help" || std::string(argv[1]) == "-h")) {
+    print_help();
+    return 0;
+  }
+
+  const int rows = argc > 1 ? std::stoi(argv[1]) : 4320;
+  const int cols = argc > 2 ? std::stoi(argv[2]) : 7680;
+  const float sigma = argc > 3 ? std::stof(argv[3]) : 5.0F;
+  const int iterations = argc > 4 ? std::stoi(argv[4]) : 5;
+  if (rows <= 0 || cols <= 0 || sigma <= 0 || iterations <= 0) {
+    print_help();
+    return 1;
+  }
+  printf("Plane %dx%d (%.1f MB), sigma %.1f, %d iterations\n", cols, rows,
+         rows * (double)cols * sizeof(float) / (1024 * 1024), sigma,
+         iterations);
+
+  for (const bool huge : {false, true}) {
+    huge_page_threshold = huge ? HUGE_PAGE_SIZE : 0;
+    const double transpose = bench_transpose(rows, cols, iterations);
+    const double blur = bench_blur(rows, cols, sigma, iterations);
+    printf("%-14s transposes %9.2f ms  blur %9.2f ms\n",
+           huge ? "2 MB pages" : "regular pages", transpose, blur);
+  }
+  huge_page_threshold = 0;
+  return 0;
+}
@@ -1,4 +1,5 @@
 #include <gaussianblur/gaussianblur.h>
+#include <gaussianblur/mapped_image.h>
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
 #include "../stb_image.h"
@@ -39,21 +40,52 @@ std::optional<std::vector<uint8_t>> read_image(const std::string& file,
   }
 
   printf("Source image: %s %dx%d (%d)\n", file.c_str(), cols, rows, channels);
-  if (channels != 3 && channels != 4) {
-    throw std::runtime_error(
-        "Image format not supported, only RGB and RGBA images are supported");
-  }
-
   return {std::vector<uint8_t>(image_data.get(),
                                image_data.get() + cols * rows * channels)};
 }
 
+std::string output_file_name(const std::string& file) {
+  const size_t dot = file.find_last_of('.');
+  return file.substr(0, dot) + std::string("_pffft") + file.substr(dot);
+}
+
+bool is_pnm(const std::string& file) {
+  const size_t dot = file.find_last_of('.');
+  if (dot == std::string::npos) return false;
+  const std::string ext = file.substr(dot + 1);
+  return ext == "ppm" || ext == "pgm" || ext == "pam";
+}
+
+// PGM/PPM/PAM are blurred straight from/to memory mapped files, without
+// decoding and copying the pixels around
+int blur_mapped(const std::string& file, const float sigma,
+                const bool apply_to_alpha) {
+  std::optional<gaussianblur::MappedImage> src =
+      gaussianblur::MappedImage::open(file);
+  if (!src.has_value()) return 1;
+
+  const ImgGeom& geom = src->geom();
+  printf("Source image (mapped): %s %dx%d (%d)\n", file.c_str(), geom.cols,
+         geom.rows, geom.channels);
+
+  std::optional<gaussianblur::MappedImage> dst =
+      gaussianblur::MappedImage::create(output_file_name(file), geom,
+                                        gaussianblur::MappedFormat::PNM);
+  if (!dst.has_value()) return 1;
+
+  return gaussianblur::gaussianblur(src.value(), dst.value(), sigma,
+                                    apply_to_alpha)
+             ? 0
+             : 1;
+}
+
 void print_help() {
   std::cout << "Usage: gaussianblur <smoothing_factor> <input_file> "
                "[apply_to_alpha]\n";
   std::cout << "  <smoothing_factor> : The smoothing factor for the Gaussian "
                "blur (must be > 0).\n";
-  std::cout << "  <input_file>       : The input image file.\n";
+  std::cout << "  <input_file>       : The input image file. PGM/PPM/PAM "
+               "files are memory mapped.\n";
   std::cout << "  [apply_to_alpha]            : Optional. If set to 1, the "
                "convolution is done on the 4th channel (alpha channel).\n";
   std::cout << "                       If not provided or set to 0, the "
@@ -85,6 +117,10 @@ int main(int argc, char* argv[]) {
     printf("Invalid smoothing factor\n");
     return 1;
   }
+  printf("SIMD kernels: %s\n",
+         gaussianblur::isa_name(gaussianblur::kernels().level));
+
+  if (is_pnm(file_name)) return blur_mapped(file_name, sigma, apply_to_alpha);
 
   int cols, rows, channels;
   std::optional<std::vector<uint8_t>> image_data;
@@ -55,11 +55,6 @@ std::optional<std::vector<uint8_t>> read_image(
   }
 
   printf("Source image: %dx%d (%d)\n", cols, rows, channels);
-  if (channels != 3 && channels != 4) {
-    throw std::runtime_error(
-        "Image format not supported, only RGB and RGBA images are supported");
-  }
-
   return {std::vector<uint8_t>(image_data.get(),
                                image_data.get() + cols * rows * channels)};
 }
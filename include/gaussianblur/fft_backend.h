@@ -0,0 +1,98 @@
+#pragma once
+
+#include <memory>
+
+namespace gaussianblur {
+
+// Order of the bins of the real spectrum of N samples
+enum class SpectrumOrder {
+  // The order of pffft_transform_ordered: the real parts of the DC and of the
+  // Nyquist bins, then the (re, im) pairs of the bins 1 to N / 2 - 1
+  PackedOrdered
+};
+
+// Layout of the signals and of the spectra of an FftSetup
+struct SpectrumLayout {
+  SpectrumOrder order;
+  // Rows transformed at once, stored sample by sample (sample n of row l at
+  // n * batch + l) if more than one
+  int batch;
+};
+
+//!
+//! \brief The real FFTs of a size of an FftBackend. Signals, spectra and the
+//! work buffer hold size() * layout().batch floats aligned to 64 bytes and
+//! must not overlap. The backward transform is not scaled, a round trip
+//! multiplies the signal by size().
+//!
+class FftSetup {
+ public:
+  virtual ~FftSetup() = default;
+
+  virtual int size() const = 0;
+  virtual SpectrumLayout layout() const = 0;
+  virtual void forward(const float *in, float *out, float *work) const = 0;
+  virtual void backward(const float *in, float *out, float *work) const = 0;
+
+  // Pruned transforms, the forward one of signals that are zeros out of
+  // [first, last) and the backward one computing the samples in [first, last)
+  // only, the others being undefined. By default the whole transforms.
+  virtual void forward_pruned(const float *in, float *out, float *work,
+                              int /*first*/, int /*last*/) const {
+    forward(in, out, work);
+  }
+  virtual void backward_pruned(const float *in, float *out, float *work,
+                               int /*first*/, int /*last*/) const {
+    backward(in, out, work);
+  }
+  // Whether a transform spreads over the threads of hybrid_loop itself, the
+  // rows are then transformed one after the other
+  virtual bool is_parallel() const { return false; }
+  // The same transforms over fewer rows at once, at least `rows`, for the
+  // last rows of a pass (e.g. the kernels of a level with fewer SIMD lanes),
+  // nullptr if there are none
+  virtual std::unique_ptr<FftSetup> narrowed(int /*rows*/) const {
+    return nullptr;
+  }
+};
+
+//!
+//! \brief A real FFT implementation convolving the rows and the columns, the
+//! tiles are padded up to a valid size of the backend.
+//!
+class FftBackend {
+ public:
+  virtual ~FftBackend() = default;
+
+  virtual const char *name() const = 0;
+  // SpectrumLayout::batch of its setups
+  virtual int batch() const = 0;
+  virtual bool is_valid_size(int size) const = 0;
+  // Smallest valid size not below `size`
+  virtual int nearest_valid_size(int size) const = 0;
+  // Transforms of a valid size, nullptr otherwise
+  virtual std::unique_ptr<FftSetup> setup(int size) const = 0;
+};
+
+// pffft: 4-lane SIMD within each row, sizes multiple of 32 with no prime
+// factor but 2, 3 and 5
+const FftBackend &pffft_backend();
+
+// The batched FFT of the kernels (see KernelTable::batched_fft): a row per
+// SIMD lane, even sizes of at least 16 whose half has no prime factor but 2, 3
+// and 5. The last rows of a pass run through the kernels of the level with the
+// fewest lanes that fit them.
+const FftBackend &batched_fft_backend();
+
+// A transform split over the threads (four-step FFT): the complex FFT of N / 2
+// points, a M1 x M2 matrix, as FFTs of its columns, twiddles and FFTs of its
+// rows through the batched FFT. Sizes multiple of 512 with no prime factor but
+// 2, 3 and 5, meant for long rows fewer than the threads or than the lanes of
+// the batched FFT.
+const FftBackend &four_step_fft_backend();
+
+// The batched FFT if the selected kernels have more SIMD lanes than pffft,
+// pffft otherwise
+const FftBackend &default_fft_backend();
+
+}  // namespace gaussianblur
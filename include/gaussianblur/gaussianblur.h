@@ -15,18 +15,208 @@ namespace gaussianblur {
  *
  * @param image_geometry The geometry of the image (dimensions and channels).
  * @param sigma The smoothing factor for the Gaussian blur.
+ * @param backend The FFT backend transforming the rows and the columns, but
+ * the long ones fewer than the threads or than the lanes of the backend,
+ * which use four_step_fft_backend().
+ * @param truncation The ratio to its peak where the Gaussian is truncated, in
+ * (0, 1], which sets the pads and so the FFT lengths.
  * @return KernelDFT The precomputed DFT of the Gaussian kernel.
  */
-KernelDFT prepare_kernel_DFT(const ImgGeom image_geometry, const float sigma);
+KernelDFT prepare_kernel_DFT(const ImgGeom image_geometry, const float sigma,
+                             const FftBackend &backend = default_fft_backend(),
+                             float truncation = 1.0F / 255);
+
+// Sample type of the intermediate and transposed planes of each channel
+enum class PlaneStorage { Float32, Float16, BFloat16 };
+
+// Statistics of a blur call, filled when requested through BlurOptions::stats
+struct BlurStats {
+  // High-water mark of the buffers allocated by the call (planes, scratch,
+  // FFT tiles, kernel and FFT setups but the pffft ones), excluding the images
+  // and the temporary tables computed while building the setups
+  size_t peak_bytes = 0;
+};
+
+// Options of a blur call, the defaults blur the color channels only
+struct BlurOptions {
+  // Blur the alpha channel of gray + alpha and RGBA images too
+  bool apply_to_alpha = false;
+  // Blur gray + alpha and RGBA images with premultiplied alpha, avoiding the
+  // color fringes of straight alpha. The colors are multiplied by alpha while
+  // deinterleaving and divided while interleaving, implies apply_to_alpha.
+  bool premultiply_alpha = false;
+  // Blur in linear light instead of on the gamma encoded sRGB values, which
+  // darkens the edges between bright and dark areas. The color channels are
+  // decoded while deinterleaving (through a LUT for 8-bit samples) and
+  // encoded back while interleaving; alpha is left as is.
+  bool linear_light = false;
+  // Blur only the channels whose bit is set, e.g. 1 << 3 for the alpha of an
+  // RGBA drop shadow. The other channels are left untouched (copied to a
+  // distinct destination). 0 selects the channels from apply_to_alpha, the
+  // mask is ignored with premultiply_alpha. When at most half of the channels
+  // are selected only their planes are deinterleaved and transformed.
+  uint32_t channel_mask = 0;
+  // Store the results of the row and column passes and the transposed planes
+  // in 16 bits, converting to float32 inside the FFT tiles and the last
+  // transpose only (with the F16C or NEON kernels when the CPU has them).
+  // Halves the traffic of the transposes and the scratch memory of each
+  // channel; Float16 suits 8-bit samples and falls back to
+  // Float32 for 16-bit samples, which exceed its range, BFloat16 keeps the
+  // range with 8 bits of mantissa.
+  PlaneStorage intermediate = PlaneStorage::Float32;
+  // Blur the channels one after the other through a single float plane and a
+  // single scratch buffer reused for every channel, instead of deinterleaving
+  // all the channels upfront. Peak memory is then about two planes (one and a
+  // half with 16-bit intermediates) above the images whatever the number of
+  // channels, at the cost of a strided pass over the image per channel.
+  // Ignored with premultiply_alpha and with partially overlapping views.
+  bool lean_memory = false;
+  // If not null, receives the statistics of the call
+  BlurStats *stats = nullptr;
+  // If not null, provides the planes, scratch buffers, FFT tiles, kernels and
+  // FFT setups of the call instead of malloc and the buffer pool, but the
+  // setups of pffft and the temporary tables computed while building a setup.
+  // The blur throws std::bad_alloc if it returns nullptr.
+  BufferAllocator *allocator = nullptr;
+  // If not null, transforms the rows and the columns instead of
+  // default_fft_backend(), e.g. to compare the backends
+  const FftBackend *fft_backend = nullptr;
+  // Ratio to its peak where the Gaussian kernel is truncated, its radius being
+  // about sigma * sqrt(2 ln(1 / truncation)). Higher values trade accuracy
+  // for shorter pads and transforms, e.g. 1 / 16 for previews. 0 picks a step
+  // of the samples: 1 / 255 for 8-bit and 1 / 65535 for 16-bit and float.
+  // Values out of [0, 1] are rejected.
+  float truncation = 0;
+};
+
+// Channel mask selecting the alpha channel only of a gray + alpha (2) or RGBA
+// (4) image
+constexpr uint32_t alpha_only_mask(const int channels) {
+  return 1U << (channels - 1);
+}
+
+/**
+ * @brief Applies Gaussian blur reading from a strided view and writing to
+ * another one, e.g. a sub-rectangle of a padded frame buffer. The views must
+ * have the same geometry and may overlap or be the same view. The samples can
+ * be uint8_t, uint16_t or float, they are blurred in float and stored back
+ * with full precision.
+ *
+ * @param src The view of the source samples, read only.
+ * @param dst The view where the blurred samples are written.
+ * @param sigma The smoothing factor for the Gaussian blur.
+ * @param options The channels to blur and how.
+ */
+template <typename T>
+void gaussianblur(const BasicImageView<T> &src, const BasicImageView<T> &dst,
+                  const float sigma, const BlurOptions &options);
+
+/**
+ * @brief Blurs and downscales by an integer factor in one go, e.g. to
+ * anti-alias thumbnails: the destination holds every factor-th row and column
+ * of the blur, from the first, without computing the others. A sigma of about
+ * factor / 2 removes most of the aliasing. The channels that are not blurred
+ * (see BlurOptions) are decimated alone; lean_memory is ignored.
+ *
+ * @param src The view of the source samples, read only.
+ * @param dst The view of ceil(rows / factor) x ceil(cols / factor) pixels of
+ * the same channels where the result is written.
+ * @param sigma The smoothing factor for the Gaussian blur.
+ * @param factor The downscaling factor, at least 1.
+ * @param options The channels to blur and how.
+ */
+template <typename T>
+void gaussianblur_downscale(const BasicImageView<T> &src,
+                            const BasicImageView<T> &dst, const float sigma,
+                            const int factor, const BlurOptions &options);
+
+/**
+ * @brief Applies Gaussian blur in place on a strided view.
+ *
+ * @param image The view of the samples to be blurred.
+ * @param sigma The smoothing factor for the Gaussian blur.
+ * @param options The channels to blur and how.
+ */
+template <typename T>
+void gaussianblur(const BasicImageView<T> &image, const float sigma,
+                  const BlurOptions &options) {
+  gaussianblur(image, image, sigma, options);
+}
+
+/**
+ * @brief Applies Gaussian blur to the image (Image, Image16 or ImageF32).
+ *
+ * @param image The image to be blurred.
+ * @param sigma The smoothing factor for the Gaussian blur.
+ * @param options The channels to blur and how.
+ */
+template <typename T>
+void gaussianblur(BasicImage<T> &image, const float sigma,
+                  const BlurOptions &options) {
+  gaussianblur(make_view(image), sigma, options);
+}
 
 /**
- * @brief Applies Gaussian blur to the image.
+ * @brief Applies Gaussian blur to the image. The samples can be uint8_t,
+ * uint16_t or float (Image, Image16 and ImageF32), they are blurred in float
+ * and stored back with full precision.
  *
  * @param image The image to be blurred.
  * @param sigma The smoothing factor for the Gaussian blur.
  * @param apply_to_alpha If true, applies the blur to the apply_to_alpha
  * channel; otherwise, applies to RGB channels.
  */
-void gaussianblur(Image &image, const float sigma, const bool apply_to_alpha);
+template <typename T>
+void gaussianblur(BasicImage<T> &image, const float sigma,
+                  const bool apply_to_alpha) {
+  gaussianblur(make_view(image), sigma, BlurOptions{apply_to_alpha});
+}
+
+/**
+ * @brief Applies Gaussian blur reading the interleaved samples from src and
+ * writing the result to dst, e.g. buffers of a MappedImage. src and dst may be
+ * the same buffer to blur in place.
+ *
+ * @param src The interleaved source samples.
+ * @param dst The interleaved destination samples, same geometry of src.
+ * @param image_geometry The geometry of both buffers.
+ * @param sigma The smoothing factor for the Gaussian blur.
+ * @param apply_to_alpha If true, applies the blur to the alpha channel too.
+ */
+template <typename T>
+void gaussianblur(const T *src, T *dst, const ImgGeom image_geometry,
+                  const float sigma, const bool apply_to_alpha) {
+  gaussianblur(make_view(const_cast<T *>(src), image_geometry),
+               make_view(dst, image_geometry), sigma,
+               BlurOptions{apply_to_alpha});
+}
+
+/**
+ * @brief Applies Gaussian blur reading from a strided view and writing to
+ * another one.
+ *
+ * @param src The view of the source samples, read only.
+ * @param dst The view where the blurred samples are written.
+ * @param sigma The smoothing factor for the Gaussian blur.
+ * @param apply_to_alpha If true, applies the blur to the alpha channel too.
+ */
+template <typename T>
+void gaussianblur(const BasicImageView<T> &src, const BasicImageView<T> &dst,
+                  const float sigma, const bool apply_to_alpha) {
+  gaussianblur(src, dst, sigma, BlurOptions{apply_to_alpha});
+}
+
+/**
+ * @brief Applies Gaussian blur in place on a strided view.
+ *
+ * @param image The view of the samples to be blurred.
+ * @param sigma The smoothing factor for the Gaussian blur.
+ * @param apply_to_alpha If true, applies the blur to the alpha channel too.
+ */
+template <typename T>
+void gaussianblur(const BasicImageView<T> &image, const float sigma,
+                  const bool apply_to_alpha) {
+  gaussianblur(image, image, sigma, BlurOptions{apply_to_alpha});
+}
 
-}  // namespace gaussianblur
\ No newline at end of file
+}  // namespace gaussianblur
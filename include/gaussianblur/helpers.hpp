@@ -1,33 +1,283 @@
 
 #pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fstream>
 #include <iostream>
+#include <list>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <numbers>
 #include <string>
 #include <thread>
 #include <vector>
-extern "C" {
-  // Forward declaration of PFFFT_Setup
-  struct PFFFT_Setup;
 
-  // Declaration of pffft_destroy_setup function
-  void pffft_destroy_setup(PFFFT_Setup *);
+#include <gaussianblur/fft_backend.h>
+#include <gaussianblur/kernels.h>
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#if defined(__APPLE__)
+#include <sys/sysctl.h>
+#endif
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__)) && !defined(__EMSCRIPTEN__)
+#include <cpuid.h>
+#define GAUSSIANBLUR_HAS_CPUID
+#endif
+#if defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+#define MALLOC_V4SF_ALIGNMENT 64
+
+// Bytes held by the aligned allocations made while it is installed in the
+// allocation_context of a thread, and their high-water mark
+struct AllocationTracker {
+  std::atomic<size_t> current{0};
+  std::atomic<size_t> peak{0};
+
+  void add(const size_t bytes) {
+    const size_t now = current += bytes;
+    size_t high = peak.load(std::memory_order_relaxed);
+    while (now > high && !peak.compare_exchange_weak(high, now)) {
+    }
+  }
+  void remove(const size_t bytes) { current -= bytes; }
+};
+
+//!
+//! \brief Memory provider of the library buffers (planes, scratch, FFT tiles
+//! and kernels), e.g. the arena of a service, installed for a blur call
+//! through BlurOptions::allocator.
+//!
+class BufferAllocator {
+ public:
+  virtual ~BufferAllocator() = default;
+  // Returns `bytes` aligned to `alignment`, or nullptr, which makes the blur
+  // throw std::bad_alloc
+  virtual void *allocate(size_t bytes, size_t alignment) = 0;
+  // Gives back a block returned by allocate with the same size
+  virtual void deallocate(void *block, size_t bytes) = 0;
+};
+
+// Tracker and allocator of the aligned allocations of the calling thread,
+// hybrid_loop hands them over to its workers
+struct AllocationContext {
+  AllocationTracker *tracker = nullptr;
+  BufferAllocator *allocator = nullptr;
+};
+inline thread_local AllocationContext allocation_context;
+
+// Blocks of at least this size are mapped with 2 MB pages on Linux, cutting
+// the TLB misses of the strided transposes of large planes. 0 disables it.
+inline std::atomic<size_t> huge_page_threshold{0};
+
+constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+// Raw memory of the aligned blocks. Huge blocks try the reserved huge pages
+// (MAP_HUGETLB) first, then a 2 MB aligned mapping advised for transparent
+// huge pages.
+static void *allocate_block(const size_t block_size, const bool huge) {
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+  if (huge) {
+    void *block = mmap(nullptr, block_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (block != MAP_FAILED) return block;
+
+    // over-map to trim the mapping to a 2 MB boundary
+    const size_t mapped_size = block_size + HUGE_PAGE_SIZE;
+    uint8_t *mapping = (uint8_t *)mmap(nullptr, mapped_size,
+                                       PROT_READ | PROT_WRITE,
+                                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) return nullptr;
+    uint8_t *aligned = (uint8_t *)(((size_t)mapping + HUGE_PAGE_SIZE - 1) &
+                                   ~(HUGE_PAGE_SIZE - 1));
+    if (aligned > mapping) munmap(mapping, aligned - mapping);
+    const size_t tail = mapping + mapped_size - (aligned + block_size);
+    if (tail) munmap(aligned + block_size, tail);
+    madvise(aligned, block_size, MADV_HUGEPAGE);
+    return aligned;
+  }
+#endif
+  return malloc(block_size);
 }
 
-#define L2_CACHE_SIZE (16 * 1024 * 1024)
-#define MALLOC_V4SF_ALIGNMENT 64
+static void free_block(void *block, const size_t block_size, const bool huge) {
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+  if (huge) {
+    munmap(block, block_size);
+    return;
+  }
+#endif
+  free(block);
+}
+
+struct BufferPoolStats {
+  // Bytes and number of the freed blocks kept for reuse
+  size_t bytes_held;
+  size_t blocks_held;
+  // Allocations served by a kept block or by malloc
+  size_t hits;
+  size_t misses;
+};
+
+//!
+//! \brief Keeps the blocks freed by Valigned_free for the next allocations of
+//! the same size class, so that the planes of back to back blurs reuse pages
+//! already faulted in instead of going through mmap/munmap every time.
+//!
+//! Sizes are rounded up to 4 classes per power of two (at most 25% of slack).
+//! The pool is empty and disabled until given a capacity, the most recently
+//! freed blocks are kept and the oldest ones are released to stay within it.
+//!
+class BufferPool {
+ public:
+  // Size of the blocks serving an allocation of `bytes`
+  static size_t size_class(const size_t bytes) {
+    if (bytes <= 256) return 256;
+    const size_t step = (size_t)1 << (std::bit_width(bytes - 1) - 3);
+    return (bytes + step - 1) & ~(step - 1);
+  }
+
+  // Max bytes held, shrinking the pool right away if needed. 0 disables it.
+  void set_capacity(const size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    capacity = bytes;
+    evict(capacity);
+  }
+
+  // Releases the oldest blocks until at most `bytes_to_keep` are held
+  void trim(const size_t bytes_to_keep = 0) {
+    std::lock_guard<std::mutex> lock(mutex);
+    evict(bytes_to_keep);
+  }
+
+  BufferPoolStats stats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return {bytes_held, blocks.size(), hits, misses};
+  }
+
+  // A kept block of the class, the most recently freed, or nullptr
+  void *acquire(const size_t block_size, const bool huge) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = blocks.rbegin(); it != blocks.rend(); ++it)
+      if (it->size == block_size && it->huge == huge) {
+        void *block = it->block;
+        bytes_held -= block_size;
+        blocks.erase(std::next(it).base());
+        ++hits;
+        return block;
+      }
+    ++misses;
+    return nullptr;
+  }
+
+  // Keeps a block, false if it doesn't fit and must be freed by the caller
+  bool release(void *block, const size_t block_size, const bool huge) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (block_size > capacity) return false;
+    evict(capacity - block_size);
+    blocks.push_back({block_size, huge, block});
+    bytes_held += block_size;
+    return true;
+  }
+
+ private:
+  struct Block {
+    size_t size;
+    bool huge;
+    void *block;
+  };
+
+  void evict(const size_t bytes_to_keep) {
+    while (bytes_held > bytes_to_keep) {
+      const Block &oldest = blocks.front();
+      bytes_held -= oldest.size;
+      free_block(oldest.block, oldest.size, oldest.huge);
+      blocks.pop_front();
+    }
+  }
+
+  std::mutex mutex;
+  // from the oldest to the most recently freed
+  std::list<Block> blocks;
+  size_t capacity = 0;
+  size_t bytes_held = 0;
+  size_t hits = 0;
+  size_t misses = 0;
+};
+
+// Pool of the process, never destroyed so that the buffers of static objects
+// can still be freed at exit
+inline BufferPool &buffer_pool() {
+  static BufferPool *pool = new BufferPool;
+  return *pool;
+}
+
+// Header stored before each aligned block
+struct AlignedBlockHeader {
+  // size requested by the caller
+  size_t bytes;
+  // allocated block, its size and whether it is mapped with huge pages
+  void *block;
+  size_t block_size;
+  bool huge;
+  // context of the allocation, to free the block the same way
+  AllocationTracker *tracker;
+  BufferAllocator *allocator;
+};
+// the aligned pointer is more than MALLOC_V4SF_ALIGNMENT past the block
+static_assert(sizeof(AlignedBlockHeader) <= MALLOC_V4SF_ALIGNMENT);
 
 static void *Valigned_malloc(size_t nb_bytes) {
-  void *p, *p0 = malloc(nb_bytes + MALLOC_V4SF_ALIGNMENT);
+  const AllocationContext context = allocation_context;
+  size_t block_size = nb_bytes + 2 * MALLOC_V4SF_ALIGNMENT;
+  bool huge = false;
+  void *p0;
+  if (context.allocator) {
+    p0 = context.allocator->allocate(block_size, MALLOC_V4SF_ALIGNMENT);
+  } else {
+    block_size = BufferPool::size_class(block_size);
+    const size_t threshold = huge_page_threshold;
+    huge = threshold && block_size >= threshold;
+    if (huge)
+      block_size = (block_size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    p0 = buffer_pool().acquire(block_size, huge);
+    if (!p0) p0 = allocate_block(block_size, huge);
+  }
   if (!p0) return (void *)0;
-  p = (void *)(((size_t)p0 + MALLOC_V4SF_ALIGNMENT) &
-               (~((size_t)(MALLOC_V4SF_ALIGNMENT - 1))));
-  *((void **)p - 1) = p0;
+
+  // the header sits right before the aligned pointer
+  void *p = (void *)(((size_t)p0 + 2 * MALLOC_V4SF_ALIGNMENT) &
+                     (~((size_t)(MALLOC_V4SF_ALIGNMENT - 1))));
+  *((AlignedBlockHeader *)p - 1) = {
+      nb_bytes, p0, block_size, huge, context.tracker, context.allocator};
+  if (context.tracker) context.tracker->add(nb_bytes);
   return p;
 }
 
 static void Valigned_free(void *p) {
-  if (p) free(*((void **)p - 1));
+  if (!p) return;
+  const AlignedBlockHeader header = *((AlignedBlockHeader *)p - 1);
+  if (header.tracker) header.tracker->remove(header.bytes);
+  if (header.allocator)
+    header.allocator->deallocate(header.block, header.block_size);
+  else if (!buffer_pool().release(header.block, header.block_size,
+                                  header.huge))
+    free_block(header.block, header.block_size, header.huge);
 }
 
 template <class T>
@@ -66,9 +316,12 @@ class PFAlloc {
     return std::numeric_limits<std::size_t>::max() / sizeof(T);
   }
 
-  // allocate but don't initialize num elements of type T
+  // allocate but don't initialize num elements of type T, throws
+  // std::bad_alloc like std::allocator if there is no memory (e.g. an
+  // exhausted BufferAllocator)
   pointer allocate(size_type num, const void * = 0) {
-    pointer ret = (pointer)Valigned_malloc(int(num) * sizeof(T));
+    pointer ret = (pointer)Valigned_malloc(num * sizeof(T));
+    if (!ret) throw std::bad_alloc();
     return ret;
   }
 
@@ -85,14 +338,50 @@ class PFAlloc {
   }
 
   // deallocate storage p of deleted elements
-  void deallocate(pointer p, size_type num) {
+  void deallocate(pointer p, size_type /*num*/) {
     // deallocate memory with pffft
     Valigned_free((void *)p);
   }
 };
 template <typename T>
 using AlignedVector = typename std::vector<T, PFAlloc<T>>;
-typedef std::vector<std::vector<float>> DeinterleavedChs;
+
+// PFAlloc default-initializing the elements, so that sizing a buffer about to
+// be overwritten doesn't zero-fill its pages for nothing
+template <class T>
+class DefaultInitAlloc : public PFAlloc<T> {
+ public:
+  template <class U>
+  struct rebind {
+    typedef DefaultInitAlloc<U> other;
+  };
+
+  DefaultInitAlloc() throw() {}
+  template <class U>
+  DefaultInitAlloc(const DefaultInitAlloc<U> &) throw() {}
+
+  template <class U>
+  void construct(U *p) {
+    new ((void *)p) U;
+  }
+  template <class U, class... Args>
+  void construct(U *p, Args &&...args) {
+    new ((void *)p) U(std::forward<Args>(args)...);
+  }
+
+  // stateless, any instance frees the storage of another one
+  template <class U>
+  bool operator==(const DefaultInitAlloc<U> &) const {
+    return true;
+  }
+  template <class U>
+  bool operator!=(const DefaultInitAlloc<U> &) const {
+    return false;
+  }
+};
+template <typename T>
+using UninitializedVector = typename std::vector<T, DefaultInitAlloc<T>>;
+typedef std::vector<UninitializedVector<float>> DeinterleavedChs;
 
 typedef struct {
   int rows;
@@ -100,37 +389,140 @@ typedef struct {
   int channels;
 } ImgGeom;
 
-typedef struct {
-  std::vector<uint8_t> data;
+// Interleaved image with samples of type T: uint8_t, uint16_t (e.g. medical
+// and astronomy images) or float (e.g. HDR renders)
+template <typename T>
+struct BasicImage {
+  std::vector<T> data;
+  ImgGeom geom;
+};
+
+using Image = BasicImage<uint8_t>;
+using Image16 = BasicImage<uint16_t>;
+using ImageF32 = BasicImage<float>;
+
+// Non-owning view over samples of type T. Strides are in bytes, so padded
+// rows, padded pixels (e.g. BGRX), planar buffers and sub-rectangles of a
+// bigger surface can be read and written in place without copies.
+template <typename T>
+struct BasicImageView {
+  T *data;
   ImgGeom geom;
-} Image;
+  // distance between the first sample of two consecutive rows
+  std::ptrdiff_t row_stride;
+  // distance between the first sample of two consecutive pixels of a row
+  std::ptrdiff_t pixel_stride;
+  // distance between two consecutive samples (channels) of the same pixel
+  std::ptrdiff_t channel_stride;
+
+  // True if the samples are tightly packed and interleaved as in BasicImage
+  bool is_contiguous() const {
+    return channel_stride == sizeof(T) &&
+           pixel_stride == (std::ptrdiff_t)(geom.channels * sizeof(T)) &&
+           row_stride == (std::ptrdiff_t)(geom.cols * geom.channels * sizeof(T));
+  }
+
+  // View of the rectangle [row, row + rows) x [col, col + cols)
+  BasicImageView subview(const int row, const int col, const int rows,
+                         const int cols) const {
+    return {(T *)((uint8_t *)data + row * row_stride + col * pixel_stride),
+            ImgGeom{rows, cols, geom.channels}, row_stride, pixel_stride,
+            channel_stride};
+  }
+};
+
+using ImageView = BasicImageView<uint8_t>;
+using ImageView16 = BasicImageView<uint16_t>;
+using ImageViewF32 = BasicImageView<float>;
+
+// View of a tightly packed interleaved buffer
+template <typename T>
+BasicImageView<T> make_view(T *data, const ImgGeom geom) {
+  return {data, geom, (std::ptrdiff_t)(geom.cols * geom.channels * sizeof(T)),
+          (std::ptrdiff_t)(geom.channels * sizeof(T)), sizeof(T)};
+}
+
+template <typename T>
+BasicImageView<T> make_view(BasicImage<T> &image) {
+  return make_view(image.data.data(), image.geom);
+}
 
 typedef struct {
   int rows;
   int cols;
 } TrailingZeros;
 
-// Custom deleter for PFFFT_Setup
-struct PFFFT_Deleter {
-  void operator()(PFFFT_Setup *setup) const {
-    if (setup) {
-      pffft_destroy_setup(setup);
+// Padded tiles laid end to end in a transform of the col and the row pass
+typedef struct {
+  int rows;
+  int cols;
+} TilesPerFFT;
+
+// Factors and twiddles of the batched FFT of the kernels (see BatchedFftPlan)
+// of a valid size of gaussianblur::batched_fft_backend()
+class BatchedFftSetup {
+ public:
+  explicit BatchedFftSetup(const int size) {
+    // radix 4 passes first, then 2, 3 and 5
+    int points = size / 2, stages = 0;
+    for (const int radix : {4, 2, 3, 5})
+      while (points % radix == 0 && points > 1) {
+        fft_plan.radix[stages++] = radix;
+        points /= radix;
+      }
+
+    const double two_pi = 2 * std::numbers::pi;
+    for (int s = 0, L = 1; s < stages; L *= fft_plan.radix[s++])
+      for (int j = 0; j < L; ++j)
+        for (int q = 1; q < fft_plan.radix[s]; ++q) {
+          const double angle = -two_pi * j * q / (L * fft_plan.radix[s]);
+          twiddles.push_back(std::cos(angle));
+          twiddles.push_back(std::sin(angle));
+        }
+    for (int k = 0; k <= size / 4; ++k) {
+      split.push_back(std::cos(-two_pi * k / size));
+      split.push_back(std::sin(-two_pi * k / size));
     }
+
+    fft_plan.size = size;
+    fft_plan.stages = stages;
+    fft_plan.twiddles = twiddles.data();
+    fft_plan.split = split.data();
   }
-};
+  BatchedFftSetup(const BatchedFftSetup &) = delete;
+  BatchedFftSetup &operator=(const BatchedFftSetup &) = delete;
 
-// Define unique_ptr types for PFFFT_Setup with custom deleter
-using PFFFT_Setup_UniquePtr = std::unique_ptr<PFFFT_Setup, PFFFT_Deleter>;
+  const gaussianblur::BatchedFftPlan &plan() const { return fft_plan; }
+
+ private:
+  AlignedVector<float> twiddles, split;
+  gaussianblur::BatchedFftPlan fft_plan = {};
+};
 
 typedef struct {
   AlignedVector<float> kerf_1D_row;
   AlignedVector<float> kerf_1D_col;
-  PFFFT_Setup_UniquePtr rows_setup;
-  PFFFT_Setup_UniquePtr cols_setup;
+  std::unique_ptr<gaussianblur::FftSetup> rows_setup;
+  std::unique_ptr<gaussianblur::FftSetup> cols_setup;
   int pad;
   TrailingZeros trailing_zeros;
+  TilesPerFFT tiles_per_fft;
 } KernelDFT;
 
+// Set on the worker threads spawned by hybrid_loop: a nested hybrid_loop (e.g.
+// the tiles of a channel while channels run in parallel) then runs serially
+// on its worker instead of oversubscribing the cores
+inline thread_local bool inside_hybrid_loop = false;
+
+// Number of threads hybrid_loop splits the work into
+inline int hybrid_loop_threads() {
+#if defined(__EMSCRIPTEN_THREADS__) || defined(ENABLE_MULTITHREADING)
+  return inside_hybrid_loop ? 1 : std::thread::hardware_concurrency();
+#else
+  return 1;
+#endif
+}
+
 template <typename T, typename op>
 void hybrid_loop(T end, op operation) {
   auto operation_wrapper = [&](T i, int tid = 0) {
@@ -140,6 +532,11 @@ void hybrid_loop(T end, op operation) {
       operation(i, tid);
   };
 #if defined(__EMSCRIPTEN_THREADS__) || defined(ENABLE_MULTITHREADING)
+  if (end <= 0) return;
+  if (inside_hybrid_loop) {
+    for (T i = 0; i < end; ++i) operation_wrapper(i);
+    return;
+  }
   const int num_threads = std::thread::hardware_concurrency();
 
   // Split in block equally for each thread. ex: 3 threads, start = 0, end = 8
@@ -153,122 +550,910 @@ void hybrid_loop(T end, op operation) {
   // Thread 2: 2
   // Thread 3: NOT SPAWNED
   const T block_size = (end + num_threads - 1) / num_threads;
+  const AllocationContext context = allocation_context;
   std::vector<std::thread> threads;
+  // integer division, a float one rounds past the end of huge loops
   const int threads_needed =
-      std::min(num_threads, (int)std::ceil(end / (float)block_size));
+      std::min<T>(num_threads, (end + block_size - 1) / block_size);
+  // a single block runs on the caller, its nested loops (e.g. the four-step
+  // FFT of a single long row) still spreading over the threads
+  if (threads_needed == 1) {
+    for (T i = 0; i < end; ++i) operation_wrapper(i);
+    return;
+  }
+  // an exception of a worker (e.g. std::bad_alloc) is rethrown on the caller
+  // once every worker is done
+  std::vector<std::exception_ptr> errors(threads_needed);
   for (int tid = 0; tid < threads_needed; ++tid) {
+    std::exception_ptr *const error = &errors[tid];
     threads.emplace_back([=]() {
+      inside_hybrid_loop = true;
+      allocation_context = context;
       T block_start = tid * block_size;
       T block_end =
           (tid == threads_needed - 1) ? end : block_start + block_size;
 
-      for (T i = block_start; i < block_end; ++i) operation_wrapper(i, tid);
+      try {
+        for (T i = block_start; i < block_end; ++i) operation_wrapper(i, tid);
+      } catch (...) {
+        *error = std::current_exception();
+      }
     });
   }
   for (auto &thread : threads) thread.join();
+  for (const std::exception_ptr &error : errors)
+    if (error) std::rethrow_exception(error);
 #else
   for (T i = 0; i < end; ++i) operation_wrapper(i);
 #endif
 }
 
+// Data cache sizes in bytes of a core, L3 being shared by the cores
+struct CacheSizes {
+  size_t l1 = 32 * 1024;
+  size_t l2 = 1024 * 1024;
+  size_t l3 = 16 * 1024 * 1024;
+};
+
+// Parses a sysfs cache size such as "48K" or "32M", 0 if malformed
+inline size_t parse_cache_size(const std::string &text) {
+  size_t i = 0, value = 0;
+  while (i < text.size() && text[i] >= '0' && text[i] <= '9')
+    value = value * 10 + (text[i++] - '0');
+  if (i == 0) return 0;
+  if (i == text.size() || text[i] == '\n') return value;
+  if (text[i] == 'K') return value * 1024;
+  if (text[i] == 'M') return value * 1024 * 1024;
+  if (text[i] == 'G') return value * 1024 * 1024 * 1024;
+  return 0;
+}
+
+// Sets the size of a data or unified cache level, ignoring the other levels
+inline void set_cache_size(CacheSizes &sizes, const int level,
+                           const size_t bytes) {
+  if (!bytes) return;
+  if (level == 1)
+    sizes.l1 = bytes;
+  else if (level == 2)
+    sizes.l2 = bytes;
+  else if (level == 3)
+    sizes.l3 = bytes;
+}
+
+#if defined(GAUSSIANBLUR_HAS_CPUID)
+// Deterministic cache parameters of CPUID leaf 4 (Intel) or 0x8000001D (AMD)
+inline bool cpuid_cache_sizes(CacheSizes &sizes, const unsigned leaf) {
+  unsigned eax, ebx, ecx, edx;
+  bool found = false;
+  for (unsigned index = 0; index < 16; ++index) {
+    if (!__get_cpuid_count(leaf, index, &eax, &ebx, &ecx, &edx)) break;
+    const unsigned type = eax & 0x1F;
+    if (type == 0) break;
+    // skip the instruction caches
+    if (type == 2) continue;
+    const size_t ways = (ebx >> 22) + 1;
+    const size_t partitions = ((ebx >> 12) & 0x3FF) + 1;
+    const size_t line_size = (ebx & 0xFFF) + 1;
+    set_cache_size(sizes, (eax >> 5) & 0x7,
+                   ways * partitions * line_size * ((size_t)ecx + 1));
+    found = true;
+  }
+  return found;
+}
+#endif
+
+// Cache sizes of the host, from sysfs or sysconf on Linux, sysctl on Apple
+// platforms and CPUID on other x86 hosts. Undetected levels keep the defaults.
+inline CacheSizes detect_cache_sizes() {
+  CacheSizes sizes;
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+  bool found = false;
+  for (int index = 0; index < 8; ++index) {
+    const std::string dir =
+        "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(index);
+    std::ifstream level_file(dir + "/level"), type_file(dir + "/type"),
+        size_file(dir + "/size");
+    int level = 0;
+    std::string type, size;
+    if (!(level_file >> level) || !(type_file >> type) ||
+        !(size_file >> size))
+      break;
+    if (type == "Instruction") continue;
+    set_cache_size(sizes, level, parse_cache_size(size));
+    found = true;
+  }
+#if defined(_SC_LEVEL1_DCACHE_SIZE)
+  if (!found) {
+    const long levels[3] = {sysconf(_SC_LEVEL1_DCACHE_SIZE),
+                            sysconf(_SC_LEVEL2_CACHE_SIZE),
+                            sysconf(_SC_LEVEL3_CACHE_SIZE)};
+    for (int level = 1; level <= 3; ++level)
+      if (levels[level - 1] > 0) {
+        set_cache_size(sizes, level, levels[level - 1]);
+        found = true;
+      }
+  }
+#endif
+#if defined(GAUSSIANBLUR_HAS_CPUID)
+  if (!found && !cpuid_cache_sizes(sizes, 4))
+    cpuid_cache_sizes(sizes, 0x8000001D);
+#endif
+#elif defined(__APPLE__)
+  const char *names[3] = {"hw.l1dcachesize", "hw.l2cachesize",
+                          "hw.l3cachesize"};
+  for (int level = 1; level <= 3; ++level) {
+    int64_t value = 0;
+    size_t length = sizeof(value);
+    if (sysctlbyname(names[level - 1], &value, &length, nullptr, 0) == 0 &&
+        value > 0)
+      set_cache_size(sizes, level, value);
+  }
+#elif defined(GAUSSIANBLUR_HAS_CPUID)
+  if (!cpuid_cache_sizes(sizes, 4)) cpuid_cache_sizes(sizes, 0x8000001D);
+#endif
+  return sizes;
+}
+
+// Cache sizes of the host, detected once
+inline const CacheSizes &cache_sizes() {
+  static const CacheSizes sizes = detect_cache_sizes();
+  return sizes;
+}
+
+// Side of the square blocks of flip_block: a block read and its transposed
+// copy fit the L2 of a core, and the blocks are halved (down to 16 pixels)
+// until every thread transposes at least one
+inline int transpose_block_size(const int w, const int h,
+                                const size_t pixel_bytes) {
+  int block = std::sqrt(cache_sizes().l2 / (2.0 * pixel_bytes));
+  block = std::max(16, block & ~15);
+  const size_t threads = hybrid_loop_threads();
+  auto blocks = [&](const int side) {
+    return (size_t)((w + side - 1) / side) * ((h + side - 1) / side);
+  };
+  while (block > 16 && blocks(block) < threads) block /= 2;
+  return block;
+}
+
+// Pixels of a (de)interleave block: its interleaved samples and its planes,
+// `pixel_bytes` per pixel, fit the L2 of a core, and the blocks are shrunk
+// (down to 64 pixels) until every thread processes at least one
+inline size_t interleave_block_size(const size_t total_size,
+                                    const size_t pixel_bytes) {
+  size_t block = std::max<size_t>(cache_sizes().l2 / pixel_bytes, 64);
+  const size_t threads = hybrid_loop_threads();
+  const size_t per_thread = (total_size + threads - 1) / threads;
+  if (per_thread < block)
+    block = std::max<size_t>((per_thread + 63) & ~(size_t)63, 64);
+  return block;
+}
+
+// IEEE 754 binary16 conversions rounding to nearest even, from
+// https://gist.github.com/rygorous/2156668
+inline uint16_t float_to_half_bits(const float value) {
+  constexpr uint32_t f32_infinity = 255U << 23;
+  constexpr uint32_t f16_max = (127U + 16) << 23;
+  constexpr uint32_t denormal_magic = ((127U - 15) + (23 - 10) + 1) << 23;
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  const uint32_t sign = bits & 0x80000000U;
+  bits ^= sign;
+
+  uint16_t half;
+  if (bits >= f16_max) {
+    // overflow to infinity, NaN stays NaN
+    half = bits > f32_infinity ? 0x7E00 : 0x7C00;
+  } else if (bits < (113U << 23)) {
+    // subnormal half: let the float addition round the mantissa
+    float magnitude, magic;
+    std::memcpy(&magnitude, &bits, sizeof(bits));
+    std::memcpy(&magic, &denormal_magic, sizeof(magic));
+    magnitude += magic;
+    std::memcpy(&bits, &magnitude, sizeof(bits));
+    half = bits - denormal_magic;
+  } else {
+    const uint32_t mantissa_odd = (bits >> 13) & 1;
+    bits += ((15U - 127) << 23) + 0xFFF + mantissa_odd;
+    half = bits >> 13;
+  }
+  return half | (sign >> 16);
+}
+
+inline float half_bits_to_float(const uint16_t half) {
+  constexpr uint32_t shifted_exponent = 0x7C00U << 13;
+  uint32_t bits = (half & 0x7FFFU) << 13;
+  const uint32_t exponent = bits & shifted_exponent;
+  bits += (127U - 15) << 23;
+  float value;
+  if (exponent == shifted_exponent) {
+    // infinity or NaN
+    bits += (128U - 16) << 23;
+    std::memcpy(&value, &bits, sizeof(bits));
+  } else if (exponent == 0) {
+    // zero or subnormal: renormalize through a float subtraction
+    bits += 1U << 23;
+    constexpr uint32_t magic_bits = 113U << 23;
+    float magic;
+    std::memcpy(&value, &bits, sizeof(bits));
+    std::memcpy(&magic, &magic_bits, sizeof(magic));
+    value -= magic;
+  } else {
+    std::memcpy(&value, &bits, sizeof(bits));
+  }
+  return (half & 0x8000U) ? -value : value;
+}
+
+// Half precision sample of the intermediate planes: 11 bits of mantissa, max
+// 65504, accurate for 8-bit images
+struct Float16 {
+  uint16_t bits;
+
+  Float16() = default;
+  Float16(const float value) : bits(float_to_half_bits(value)) {}
+  operator float() const { return half_bits_to_float(bits); }
+};
+
+// Brain float sample of the intermediate planes: the exponent of a float with
+// 8 bits of mantissa, rounded to nearest even
+struct BFloat16 {
+  uint16_t bits;
+
+  BFloat16() = default;
+  BFloat16(const float value) {
+    uint32_t value_bits;
+    std::memcpy(&value_bits, &value, sizeof(value_bits));
+    bits = (value_bits + 0x7FFFU + ((value_bits >> 16) & 1)) >> 16;
+  }
+  operator float() const {
+    const uint32_t value_bits = (uint32_t)bits << 16;
+    float value;
+    std::memcpy(&value, &value_bits, sizeof(value));
+    return value;
+  }
+};
+
+// Copies n samples converting them, used to move the tiles of the FFT between
+// the float32 domain and the storage of the planes
+template <typename T, typename U>
+void convert_n(const T *in, const size_t n, U *out) {
+  std::copy_n(in, n, out);
+}
+
+inline void convert_n(const Float16 *in, const size_t n, float *out) {
+  size_t i =
+      gaussianblur::kernels().half_to_float((const uint16_t *)in, out, n);
+  for (; i < n; ++i) out[i] = in[i];
+}
+
+inline void convert_n(const float *in, const size_t n, Float16 *out) {
+  size_t i = gaussianblur::kernels().float_to_half(in, (uint16_t *)out, n);
+  for (; i < n; ++i) out[i] = in[i];
+}
+
 //!
 //! \brief This function performs a 2D tranposition of an image.
 //!
 //! The transposition is done per
 //! block to reduce the number of cache misses and improve cache coherency for
 //! large image buffers. Templated by buffer data type T and buffer number of
-//! channels C.
+//! channels C. Inside a block, pixels of 2 or 4 bytes are transposed in SIMD
+//! tiles by the kernels of the CPU, and outputs larger than the last level
+//! cache are written with non-temporal stores. A block to convert is first
+//! converted row by row with convert_n into a buffer of the thread.
 //!
 //! \param[in] in           source buffer
-//! \param[in,out] out      target buffer
+//! \param[in,out] out      target buffer, converting the samples if its type
+//!                         differs
 //! \param[in] w            image width
 //! \param[in] h            image height
 //!
-template <int C, typename T>
-void flip_block(const T *in, T *out, const int w, const int h) {
-  // Suppose a square block of L2 cache size = 16MB
-  // to be divided for the num of channels and bytes
-  const int block = sqrt((double)L2_CACHE_SIZE / (C * sizeof(T)));
+template <int C, typename T, typename U = T>
+void flip_block(const T *in, U *out, const int w, const int h) {
+  const int block =
+      transpose_block_size(w, h, C * std::max(sizeof(T), sizeof(U)));
   const int w_blocks = std::ceil((float)w / block);
   const int h_blocks = std::ceil((float)h / block);
   const int last_blockx = w % block == 0 ? block : w % block;
   const int last_blocky = h % block == 0 ? block : h % block;
 
-  hybrid_loop(w_blocks * h_blocks, [&](int n) {
+  // register tiles of the kernels selected at runtime
+  constexpr size_t pixel_bytes = C * sizeof(U);
+  const gaussianblur::KernelTable &kernels = gaussianblur::kernels();
+  int tile = 0;
+  if (pixel_bytes == 4)
+    tile = kernels.transpose_tile_32;
+  else if (pixel_bytes == 2)
+    tile = kernels.transpose_tile_16;
+  const auto transpose_tiles = pixel_bytes == 4 ? kernels.transpose_tiles_32
+                                                : kernels.transpose_tiles_16;
+  // the tiles of a block start at multiples of the tile in both planes, their
+  // rows are aligned if the output and its rows are
+  const size_t tile_row_bytes = tile * pixel_bytes;
+  const bool stream =
+      tile && (size_t)w * h * pixel_bytes > cache_sizes().l3 &&
+      (size_t)out % tile_row_bytes == 0 &&
+      (size_t)h * pixel_bytes % tile_row_bytes == 0;
+
+  // converted blocks of each thread, allocated on first use
+  constexpr bool convert = !std::is_same_v<T, U>;
+  std::vector<AlignedVector<U>> converted(convert ? hybrid_loop_threads() : 0);
+
+  hybrid_loop(w_blocks * h_blocks, [&](const int n, const int tid) {
     const int x = n / h_blocks;
     const int y = n % h_blocks;
     const int blockx = (x == w_blocks - 1) ? last_blockx : block;
     const int blocky = (y == h_blocks - 1) ? last_blocky : block;
 
-    const T *p = in + block * (y * w * C + x * C);
-    T *q = out + block * (y * C + x * h * C);
+    const T *block_in = in + (size_t)block * C * ((size_t)y * w + x);
+    U *q = out + (size_t)block * C * (y + (size_t)x * h);
+
+    // source pixels of the block and pixels between two of its rows
+    const U *p;
+    size_t stride;
+    if constexpr (convert) {
+      AlignedVector<U> &buffer = converted.at(tid);
+      buffer.resize((size_t)block * block * C);
+      for (int yy = 0; yy < blocky; yy++)
+        convert_n(block_in + (size_t)yy * w * C, (size_t)blockx * C,
+                  buffer.data() + (size_t)yy * blockx * C);
+      p = buffer.data();
+      stride = blockx;
+    } else {
+      p = block_in;
+      stride = w;
+    }
+
+    int tiled_x = 0, tiled_y = 0;
+    if (tile > 0) {
+      tiled_x = blockx - blockx % tile;
+      tiled_y = blocky - blocky % tile;
+      transpose_tiles(p, stride, q, h, blockx, blocky, stream);
+    }
 
+    // the pixels out of the tiles one by one
     for (int xx = 0; xx < blockx; xx++) {
-      for (int yy = 0; yy < blocky; yy++) {
-        for (int k = 0; k < C; k++) q[k] = p[k];
-        p += w * C;
-        q += C;
+      for (int yy = xx < tiled_x ? tiled_y : 0; yy < blocky; yy++) {
+        const U *src = p + ((size_t)yy * stride + xx) * C;
+        U *dst = q + ((size_t)xx * h + yy) * C;
+        for (int k = 0; k < C; k++) dst[k] = src[k];
       }
-      p += C * (1 - blocky * w);
-      q += C * (h - blocky);
     }
   });
 }
 
-template <uint32_t Channels, typename T, typename U>
+// Hook of the (de)interleave kernels, called on the planes of every cache
+// block while it is still hot: after the block has been deinterleaved or
+// before it is interleaved
+struct NoBlockOp {
+  template <typename U>
+  void operator()(U *const *, const int) const {}
+};
+
+// Whether every sample of the plane equals the first one, bailing out at the
+// first 16 samples block that differs
+inline bool is_constant_plane(const float *plane, const size_t size) {
+  if (size == 0) return true;
+  const float first = plane[0];
+  size_t i = 0;
+#if defined(__SSE2__)
+  const __m128 value = _mm_set1_ps(first);
+  for (; i + 16 <= size; i += 16) {
+    const __m128 eq = _mm_and_ps(
+        _mm_and_ps(_mm_cmpeq_ps(_mm_loadu_ps(plane + i), value),
+                   _mm_cmpeq_ps(_mm_loadu_ps(plane + i + 4), value)),
+        _mm_and_ps(_mm_cmpeq_ps(_mm_loadu_ps(plane + i + 8), value),
+                   _mm_cmpeq_ps(_mm_loadu_ps(plane + i + 12), value)));
+    if (_mm_movemask_ps(eq) != 0xF) return false;
+  }
+#elif defined(__wasm_simd128__)
+  const v128_t value = wasm_f32x4_splat(first);
+  for (; i + 16 <= size; i += 16) {
+    const v128_t eq = wasm_v128_and(
+        wasm_v128_and(wasm_f32x4_eq(wasm_v128_load(plane + i), value),
+                      wasm_f32x4_eq(wasm_v128_load(plane + i + 4), value)),
+        wasm_v128_and(wasm_f32x4_eq(wasm_v128_load(plane + i + 8), value),
+                      wasm_f32x4_eq(wasm_v128_load(plane + i + 12), value)));
+    if (!wasm_i32x4_all_true(eq)) return false;
+  }
+#elif defined(__aarch64__)
+  const float32x4_t value = vdupq_n_f32(first);
+  for (; i + 16 <= size; i += 16) {
+    const uint32x4_t eq = vandq_u32(
+        vandq_u32(vceqq_f32(vld1q_f32(plane + i), value),
+                  vceqq_f32(vld1q_f32(plane + i + 4), value)),
+        vandq_u32(vceqq_f32(vld1q_f32(plane + i + 8), value),
+                  vceqq_f32(vld1q_f32(plane + i + 12), value)));
+    if (!vminvq_u32(eq)) return false;
+  }
+#endif
+  for (; i < size; ++i)
+    if (plane[i] != first) return false;
+  return true;
+}
+
+enum AlphaRun { ALPHA_MIXED, ALPHA_OPAQUE, ALPHA_TRANSPARENT };
+
+// Classifies a run of 4 alpha samples, so that fully opaque or fully
+// transparent runs skip the per-pixel (un)premultiplication
+inline AlphaRun classify_alpha_run(const float *alpha, const float opaque,
+                                   const float transparent) {
+#if defined(__SSE2__)
+  const __m128 a = _mm_loadu_ps(alpha);
+  if (_mm_movemask_ps(_mm_cmpge_ps(a, _mm_set1_ps(opaque))) == 0xF)
+    return ALPHA_OPAQUE;
+  if (_mm_movemask_ps(_mm_cmple_ps(a, _mm_set1_ps(transparent))) == 0xF)
+    return ALPHA_TRANSPARENT;
+#elif defined(__wasm_simd128__)
+  const v128_t a = wasm_v128_load(alpha);
+  if (wasm_i32x4_all_true(wasm_f32x4_ge(a, wasm_f32x4_splat(opaque))))
+    return ALPHA_OPAQUE;
+  if (wasm_i32x4_all_true(wasm_f32x4_le(a, wasm_f32x4_splat(transparent))))
+    return ALPHA_TRANSPARENT;
+#elif defined(__aarch64__)
+  const float32x4_t a = vld1q_f32(alpha);
+  if (vminvq_u32(vcgeq_f32(a, vdupq_n_f32(opaque)))) return ALPHA_OPAQUE;
+  if (vminvq_u32(vcleq_f32(a, vdupq_n_f32(transparent))))
+    return ALPHA_TRANSPARENT;
+#else
+  if (alpha[0] >= opaque && alpha[1] >= opaque && alpha[2] >= opaque &&
+      alpha[3] >= opaque)
+    return ALPHA_OPAQUE;
+  if (alpha[0] <= transparent && alpha[1] <= transparent &&
+      alpha[2] <= transparent && alpha[3] <= transparent)
+    return ALPHA_TRANSPARENT;
+#endif
+  return ALPHA_MIXED;
+}
+
+//!
+//! \brief Block hook multiplying the color planes by the alpha plane (the
+//! last one), with `opaque` the alpha value of a fully opaque pixel.
+//!
+template <uint32_t Channels>
+struct PremultiplyAlpha {
+  float opaque;
+
+  void operator()(float *const *planes, const int count) const {
+    const float *const alpha = planes[Channels - 1];
+    const float scale = 1.0F / opaque;
+    int xx = 0;
+    for (; xx + 4 <= count; xx += 4) {
+      const AlphaRun run = classify_alpha_run(alpha + xx, opaque, 0.0F);
+      if (run == ALPHA_OPAQUE) continue;
+      for (uint32_t c = 0; c < Channels - 1; ++c) {
+        float *const color = planes[c] + xx;
+        if (run == ALPHA_TRANSPARENT)
+          std::fill_n(color, 4, 0.0F);
+        else
+          for (int k = 0; k < 4; ++k) color[k] *= alpha[xx + k] * scale;
+      }
+    }
+    for (; xx < count; ++xx)
+      for (uint32_t c = 0; c < Channels - 1; ++c)
+        planes[c][xx] *= alpha[xx] * scale;
+  }
+};
+
+//!
+//! \brief Block hook dividing the blurred color planes by the blurred alpha
+//! plane. Pixels that turned (almost) transparent get a 0 color, the others
+//! are clamped to `max_color` (the opaque value for integer samples).
+//!
+template <uint32_t Channels>
+struct UnpremultiplyAlpha {
+  float opaque;
+  float max_color;
+
+  void operator()(float *const *planes, const int count) const {
+    const float *const alpha = planes[Channels - 1];
+    // a blurred opaque region is opaque up to the float rounding
+    const float opaque_from = opaque * (1.0F - 1e-5F);
+    const float transparent_up_to = opaque * 1e-5F;
+    int xx = 0;
+    for (; xx + 4 <= count; xx += 4) {
+      const AlphaRun run =
+          classify_alpha_run(alpha + xx, opaque_from, transparent_up_to);
+      if (run == ALPHA_OPAQUE) continue;
+      for (uint32_t c = 0; c < Channels - 1; ++c) {
+        float *const color = planes[c] + xx;
+        if (run == ALPHA_TRANSPARENT)
+          std::fill_n(color, 4, 0.0F);
+        else
+          for (int k = 0; k < 4; ++k)
+            color[k] = alpha[xx + k] > transparent_up_to
+                           ? std::min(color[k] * opaque / alpha[xx + k],
+                                      max_color)
+                           : 0.0F;
+      }
+    }
+    for (; xx < count; ++xx)
+      for (uint32_t c = 0; c < Channels - 1; ++c)
+        planes[c][xx] = alpha[xx] > transparent_up_to
+                            ? std::min(planes[c][xx] * opaque / alpha[xx],
+                                       max_color)
+                            : 0.0F;
+  }
+};
+
+// Runs two block hooks one after the other
+template <typename First, typename Second>
+struct ChainedBlockOps {
+  First first;
+  Second second;
+
+  template <typename U>
+  void operator()(U *const *planes, const int count) const {
+    first(planes, count);
+    second(planes, count);
+  }
+};
+
+template <typename First, typename Second>
+ChainedBlockOps<First, Second> chain_block_ops(const First &first,
+                                               const Second &second) {
+  return {first, second};
+}
+
+// Channels holding a color, i.e. all but the alpha of gray + alpha and RGBA
+template <uint32_t Channels>
+constexpr uint32_t color_channels() {
+  return Channels == 2 || Channels == 4 ? Channels - 1 : Channels;
+}
+
+// sRGB electro-optical transfer function, s and the result in [0, 1]
+inline float srgb_to_linear(const float s) {
+  return s <= 0.04045F ? s / 12.92F : std::pow((s + 0.055F) / 1.055F, 2.4F);
+}
+
+// Inverse of srgb_to_linear, c and the result in [0, 1]
+inline float linear_to_srgb(const float c) {
+  return c <= 0.0031308F ? c * 12.92F
+                         : 1.055F * std::pow(c, 1.0F / 2.4F) - 0.055F;
+}
+
+// Linear value (scaled to [0, 255]) of every 8-bit sRGB value
+inline const float *srgb_to_linear_lut() {
+  static const std::array<float, 256> lut = [] {
+    std::array<float, 256> table;
+    for (int i = 0; i < 256; ++i)
+      table[i] = srgb_to_linear(i / 255.0F) * 255.0F;
+    return table;
+  }();
+  return lut.data();
+}
+
+// Ian Taylor's approximation of linear_to_srgb as a sum of nested square
+// roots, vectorizable and within 0.25 / 255 of the exact curve
+inline float linear_to_srgb_approx(const float c) {
+  const float s1 = std::sqrt(c);
+  const float s2 = std::sqrt(s1);
+  const float s3 = std::sqrt(s2);
+  const float s =
+      0.662002687F * s1 + 0.684122060F * s2 - 0.323583601F * s3 -
+      0.0225411470F * c;
+  return c <= 0.0031308F ? c * 12.92F : s;
+}
+
+// linear_to_srgb_approx of n values in [0, scale], in place
+inline void linear_to_srgb_approx(float *values, const int n,
+                                  const float scale) {
+  const float inv_scale = 1.0F / scale;
+  int i = 0;
+#if defined(__SSE2__) || defined(__wasm_simd128__) || defined(__aarch64__)
+  for (; i + 4 <= n; i += 4) {
+#if defined(__SSE2__)
+    const __m128 c = _mm_min_ps(
+        _mm_max_ps(_mm_mul_ps(_mm_loadu_ps(values + i), _mm_set1_ps(inv_scale)),
+                   _mm_setzero_ps()),
+        _mm_set1_ps(1.0F));
+    const __m128 s1 = _mm_sqrt_ps(c);
+    const __m128 s2 = _mm_sqrt_ps(s1);
+    const __m128 s3 = _mm_sqrt_ps(s2);
+    const __m128 curve = _mm_sub_ps(
+        _mm_add_ps(_mm_mul_ps(s1, _mm_set1_ps(0.662002687F)),
+                   _mm_mul_ps(s2, _mm_set1_ps(0.684122060F))),
+        _mm_add_ps(_mm_mul_ps(s3, _mm_set1_ps(0.323583601F)),
+                   _mm_mul_ps(c, _mm_set1_ps(0.0225411470F))));
+    const __m128 linear = _mm_mul_ps(c, _mm_set1_ps(12.92F));
+    const __m128 is_linear = _mm_cmple_ps(c, _mm_set1_ps(0.0031308F));
+    const __m128 s = _mm_or_ps(_mm_and_ps(is_linear, linear),
+                               _mm_andnot_ps(is_linear, curve));
+    _mm_storeu_ps(values + i, _mm_mul_ps(s, _mm_set1_ps(scale)));
+#elif defined(__wasm_simd128__)
+    const v128_t c = wasm_f32x4_min(
+        wasm_f32x4_max(wasm_f32x4_mul(wasm_v128_load(values + i),
+                                      wasm_f32x4_splat(inv_scale)),
+                       wasm_f32x4_splat(0.0F)),
+        wasm_f32x4_splat(1.0F));
+    const v128_t s1 = wasm_f32x4_sqrt(c);
+    const v128_t s2 = wasm_f32x4_sqrt(s1);
+    const v128_t s3 = wasm_f32x4_sqrt(s2);
+    const v128_t curve = wasm_f32x4_sub(
+        wasm_f32x4_add(wasm_f32x4_mul(s1, wasm_f32x4_splat(0.662002687F)),
+                       wasm_f32x4_mul(s2, wasm_f32x4_splat(0.684122060F))),
+        wasm_f32x4_add(wasm_f32x4_mul(s3, wasm_f32x4_splat(0.323583601F)),
+                       wasm_f32x4_mul(c, wasm_f32x4_splat(0.0225411470F))));
+    const v128_t linear = wasm_f32x4_mul(c, wasm_f32x4_splat(12.92F));
+    const v128_t s = wasm_v128_bitselect(
+        linear, curve, wasm_f32x4_le(c, wasm_f32x4_splat(0.0031308F)));
+    wasm_v128_store(values + i, wasm_f32x4_mul(s, wasm_f32x4_splat(scale)));
+#else
+    const float32x4_t c = vminq_f32(
+        vmaxq_f32(vmulq_n_f32(vld1q_f32(values + i), inv_scale),
+                  vdupq_n_f32(0.0F)),
+        vdupq_n_f32(1.0F));
+    const float32x4_t s1 = vsqrtq_f32(c);
+    const float32x4_t s2 = vsqrtq_f32(s1);
+    const float32x4_t s3 = vsqrtq_f32(s2);
+    const float32x4_t curve = vsubq_f32(
+        vaddq_f32(vmulq_n_f32(s1, 0.662002687F),
+                  vmulq_n_f32(s2, 0.684122060F)),
+        vaddq_f32(vmulq_n_f32(s3, 0.323583601F),
+                  vmulq_n_f32(c, 0.0225411470F)));
+    const float32x4_t linear = vmulq_n_f32(c, 12.92F);
+    const float32x4_t s = vbslq_f32(vcleq_f32(c, vdupq_n_f32(0.0031308F)),
+                                    linear, curve);
+    vst1q_f32(values + i, vmulq_n_f32(s, scale));
+#endif
+  }
+#endif
+  for (; i < n; ++i)
+    values[i] = linear_to_srgb_approx(
+                    std::clamp(values[i] * inv_scale, 0.0F, 1.0F)) *
+                scale;
+}
+
+//!
+//! \brief Block hook decoding the sRGB color planes to linear light, keeping
+//! the [0, `scale`] range. 8-bit samples go through a 256 entries LUT, the
+//! others through the exact transfer function.
+//!
+template <uint32_t Channels>
+struct SrgbToLinear {
+  float scale;
+  bool lut;
+
+  void operator()(float *const *planes, const int count) const {
+    const float *const table = srgb_to_linear_lut();
+    for (uint32_t c = 0; c < color_channels<Channels>(); ++c) {
+      float *const plane = planes[c];
+      if (lut)
+        for (int xx = 0; xx < count; ++xx) plane[xx] = table[(int)plane[xx]];
+      else
+        for (int xx = 0; xx < count; ++xx)
+          plane[xx] = srgb_to_linear(plane[xx] / scale) * scale;
+    }
+  }
+};
+
+//!
+//! \brief Block hook encoding the linear color planes back to sRGB. 8-bit
+//! samples use the SIMD approximation, finer samples the exact function.
+//!
+template <uint32_t Channels>
+struct LinearToSrgb {
+  float scale;
+  bool approx;
+
+  void operator()(float *const *planes, const int count) const {
+    for (uint32_t c = 0; c < color_channels<Channels>(); ++c) {
+      float *const plane = planes[c];
+      if (approx)
+        linear_to_srgb_approx(plane, count, scale);
+      else
+        for (int xx = 0; xx < count; ++xx)
+          plane[xx] =
+              linear_to_srgb(std::clamp(plane[xx] / scale, 0.0F, 1.0F)) *
+              scale;
+    }
+  }
+};
+
+// Blocks of `block` samples covering `total_size` samples, the last one
+// possibly shorter
+struct BlockPartition {
+  size_t count;
+  size_t last_block_size;
+};
+
+constexpr BlockPartition partition_blocks(const size_t total_size,
+                                          const size_t block) {
+  return {(total_size + block - 1) / block,
+          total_size % block == 0 ? block : total_size % block};
+}
+
+// Converts a sample, rounding float samples to integer ones and saturating
+// them to the range of the integer type, e.g. the ringing overshoots of 8-bit
+// images clamp to 255 instead of wrapping around
+template <typename T, typename U>
+inline T convert_sample(const U value) {
+  if constexpr (std::is_integral_v<T> && !std::is_integral_v<U>)
+    return (T)std::min(std::max(0.0F, (float)value + 0.5F),
+                       (float)std::numeric_limits<T>::max());
+  else
+    return (T)value;
+}
+
+template <uint32_t Channels, typename T, typename U,
+          typename BlockOp = NoBlockOp>
 void deinterleave_channels(const T *const interleaved, U **const deinterleaved,
-                           const uint32_t total_size) {
-  // Cache-friendly deinterleave, splitting for blocks of 16 MB, inspired by
-  // flip-block
-  constexpr float round =
-      std::is_integral_v<U> ? std::is_integral_v<T> ? 0 : 0.5F : 0;
-  constexpr uint32_t block =
-      L2_CACHE_SIZE / (Channels * std::max(sizeof(T), sizeof(U)));
-  const uint32_t num_blocks = std::ceil(total_size / (float)block);
-  const uint32_t last_block_size =
-      total_size % block == 0 ? block : total_size % block;
-
-  hybrid_loop(num_blocks, [&](auto n) {
-    const uint32_t x = n * block;
+                           const size_t total_size,
+                           const BlockOp &block_op = {}) {
+  // Cache-friendly deinterleave, splitting in blocks fitting the L2 cache,
+  // inspired by flip-block
+  const size_t block =
+      interleave_block_size(total_size, Channels * (sizeof(T) + sizeof(U)));
+  const BlockPartition blocks = partition_blocks(total_size, block);
+
+  hybrid_loop(blocks.count, [&](auto n) {
+    const size_t x = n * block;
     U *channel_ptrs[Channels];
     for (uint32_t c = 0; c < Channels; ++c) {
       channel_ptrs[c] = deinterleaved[c] + x;
     }
     const T *const interleaved_ptr = interleaved + (x * Channels);
 
-    const int blockx = (n == num_blocks - 1) ? last_block_size : block;
-    for (int xx = 0; xx < blockx; ++xx) {
+    const int blockx =
+        (n == blocks.count - 1) ? blocks.last_block_size : block;
+    int xx = 0;
+    if constexpr (std::is_same_v<T, uint8_t> && std::is_same_v<U, float> &&
+                  (Channels == 3 || Channels == 4))
+      xx = Channels == 3
+               ? gaussianblur::kernels().deinterleave_rgb8(interleaved_ptr,
+                                                           channel_ptrs, blockx)
+               : gaussianblur::kernels().deinterleave_rgba8(
+                     interleaved_ptr, channel_ptrs, blockx);
+    for (; xx < blockx; ++xx) {
       for (uint32_t c = 0; c < Channels; ++c) {
-        channel_ptrs[c][xx] = interleaved_ptr[(xx * Channels) + c] + round;
+        channel_ptrs[c][xx] =
+            convert_sample<U>(interleaved_ptr[(xx * Channels) + c]);
       }
     }
+    block_op(channel_ptrs, blockx);
   });
 }
 
-template <uint32_t Channels, typename T, typename U>
-void interleave_channels(const U **const deinterleaved, T *const interleaved,
-                         const uint32_t total_size) {
-  constexpr float round =
-      std::is_integral_v<T> ? std::is_integral_v<U> ? 0 : 0.5F : 0;
-  constexpr uint32_t block =
-      L2_CACHE_SIZE / (Channels * std::max(sizeof(T), sizeof(U)));
-  const uint32_t num_blocks = std::ceil(total_size / (float)block);
-  const uint32_t last_block_size =
-      total_size % block == 0 ? block : total_size % block;
-
-  hybrid_loop(num_blocks, [&](auto n) {
-    const uint32_t x = n * block;
-    const U *channel_ptrs[Channels];
+template <uint32_t Channels, typename T, typename U,
+          typename BlockOp = NoBlockOp>
+void interleave_channels(U **const deinterleaved, T *const interleaved,
+                         const size_t total_size,
+                         const BlockOp &block_op = {}) {
+  const size_t block =
+      interleave_block_size(total_size, Channels * (sizeof(T) + sizeof(U)));
+  const BlockPartition blocks = partition_blocks(total_size, block);
+
+  hybrid_loop(blocks.count, [&](auto n) {
+    const size_t x = n * block;
+    U *channel_ptrs[Channels];
     for (uint32_t c = 0; c < Channels; ++c) {
       channel_ptrs[c] = deinterleaved[c] + x;
     }
     T *const interleaved_ptr = interleaved + x * Channels;
 
-    const int blockx = (n == num_blocks - 1) ? last_block_size : block;
-    for (int xx = 0; xx < blockx; ++xx) {
+    const int blockx =
+        (n == blocks.count - 1) ? blocks.last_block_size : block;
+    block_op(channel_ptrs, blockx);
+    int xx = 0;
+    if constexpr (std::is_same_v<T, uint8_t> && std::is_same_v<U, float> &&
+                  (Channels == 3 || Channels == 4))
+      xx = Channels == 3
+               ? gaussianblur::kernels().interleave_rgb8(channel_ptrs,
+                                                         interleaved_ptr, blockx)
+               : gaussianblur::kernels().interleave_rgba8(
+                     channel_ptrs, interleaved_ptr, blockx);
+    for (; xx < blockx; ++xx) {
       for (uint32_t c = 0; c < Channels; ++c) {
-        interleaved_ptr[xx * Channels + c] = channel_ptrs[c][xx] + round;
+        interleaved_ptr[xx * Channels + c] =
+            convert_sample<T>(channel_ptrs[c][xx]);
       }
     }
   });
-}
\ No newline at end of file
+}
+
+//!
+//! \brief Runtime channels counterpart of deinterleave_channels, e.g. for
+//! multispectral images. Each cache block is walked once per channel, so that
+//! every plane is written sequentially while the block stays in cache.
+//!
+template <typename T, typename U>
+void deinterleave_channels(const T *const interleaved, U **const deinterleaved,
+                           const size_t total_size, const uint32_t channels) {
+  const size_t block =
+      interleave_block_size(total_size, channels * (sizeof(T) + sizeof(U)));
+  const BlockPartition blocks = partition_blocks(total_size, block);
+
+  hybrid_loop(blocks.count, [&](auto n) {
+    const size_t x = n * block;
+    const T *const interleaved_ptr = interleaved + x * channels;
+    const int blockx =
+        (n == blocks.count - 1) ? blocks.last_block_size : block;
+    for (uint32_t c = 0; c < channels; ++c) {
+      U *const channel_ptr = deinterleaved[c] + x;
+      for (int xx = 0; xx < blockx; ++xx)
+        channel_ptr[xx] =
+            convert_sample<U>(interleaved_ptr[(size_t)xx * channels + c]);
+    }
+  });
+}
+
+//!
+//! \brief Runtime channels counterpart of interleave_channels.
+//!
+template <typename T, typename U>
+void interleave_channels(U **const deinterleaved, T *const interleaved,
+                         const size_t total_size, const uint32_t channels) {
+  const size_t block =
+      interleave_block_size(total_size, channels * (sizeof(T) + sizeof(U)));
+  const BlockPartition blocks = partition_blocks(total_size, block);
+
+  hybrid_loop(blocks.count, [&](auto n) {
+    const size_t x = n * block;
+    T *const interleaved_ptr = interleaved + x * channels;
+    const int blockx =
+        (n == blocks.count - 1) ? blocks.last_block_size : block;
+    for (uint32_t c = 0; c < channels; ++c) {
+      const U *const channel_ptr = deinterleaved[c] + x;
+      for (int xx = 0; xx < blockx; ++xx)
+        interleaved_ptr[(size_t)xx * channels + c] =
+            convert_sample<T>(channel_ptr[xx]);
+    }
+  });
+}
+
+//!
+//! \brief Strided counterpart of deinterleave_channels for ImageView sources
+//! that are not tightly packed. Strides are expressed in bytes.
+//!
+template <typename T, typename U, typename BlockOp = NoBlockOp>
+void deinterleave_channels_strided(const T *const interleaved,
+                                   U **const deinterleaved, const int rows,
+                                   const int cols, const int channels,
+                                   const std::ptrdiff_t row_stride,
+                                   const std::ptrdiff_t pixel_stride,
+                                   const std::ptrdiff_t channel_stride,
+                                   const BlockOp &block_op = {}) {
+  const uint8_t *const base = (const uint8_t *)interleaved;
+
+  hybrid_loop(rows, [&](auto y) {
+    const uint8_t *row = base + y * row_stride;
+    for (int c = 0; c < channels; ++c) {
+      U *const channel_row = deinterleaved[c] + (std::ptrdiff_t)y * cols;
+      const uint8_t *sample = row + c * channel_stride;
+      for (int x = 0; x < cols; ++x, sample += pixel_stride)
+        channel_row[x] = convert_sample<U>(*(const T *)sample);
+    }
+    std::vector<U *> channel_rows(channels);
+    for (int c = 0; c < channels; ++c)
+      channel_rows[c] = deinterleaved[c] + (std::ptrdiff_t)y * cols;
+    block_op(channel_rows.data(), cols);
+  });
+}
+
+//!
+//! \brief Strided counterpart of interleave_channels for ImageView targets
+//! that are not tightly packed. Strides are expressed in bytes.
+//!
+template <typename T, typename U, typename BlockOp = NoBlockOp>
+void interleave_channels_strided(U **const deinterleaved,
+                                 T *const interleaved, const int rows,
+                                 const int cols, const int channels,
+                                 const std::ptrdiff_t row_stride,
+                                 const std::ptrdiff_t pixel_stride,
+                                 const std::ptrdiff_t channel_stride,
+                                 const BlockOp &block_op = {}) {
+  uint8_t *const base = (uint8_t *)interleaved;
+
+  hybrid_loop(rows, [&](auto y) {
+    uint8_t *row = base + y * row_stride;
+    std::vector<U *> channel_rows(channels);
+    for (int c = 0; c < channels; ++c)
+      channel_rows[c] = deinterleaved[c] + (std::ptrdiff_t)y * cols;
+    block_op(channel_rows.data(), cols);
+    for (int c = 0; c < channels; ++c) {
+      U *const channel_row = channel_rows[c];
+      uint8_t *sample = row + c * channel_stride;
+      for (int x = 0; x < cols; ++x, sample += pixel_stride)
+        *(T *)sample = convert_sample<T>(channel_row[x]);
+    }
+  });
+}
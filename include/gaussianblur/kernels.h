@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace gaussianblur {
+
+// Instruction set levels of the multi-versioned kernels, from the oldest
+enum class IsaLevel {
+  // the flags of the build: SSE2 on x86-64, NEON on AArch64, simd128 on WASM
+  Baseline,
+  // SSE4.1 (SSSE3 byte shuffles and widening conversions) on x86
+  SSE41,
+  // AVX2 + FMA + F16C
+  AVX2,
+  // AVX-512 F/BW/VL on top of AVX2
+  AVX512
+};
+
+// Factors and twiddles of the batched real FFT of `size` samples, an even size
+// of at least 16 whose half has no prime factor but 2, 3 and 5, built by
+// BatchedFftSetup and shared by every level
+struct BatchedFftPlan {
+  int size;
+  // radices of the passes of the complex FFT of size / 2 points
+  int stages;
+  int radix[32];
+  // (re, im) of exp(-2 pi i j q / (L radix)) for the j < L of each pass and
+  // 0 < q < radix, L being the product of the previous radices
+  const float *twiddles;
+  // (re, im) of exp(-2 pi i k / size), k <= size / 4, splitting the complex
+  // FFT into the real one
+  const float *split;
+};
+
+//!
+//! \brief Hot loops compiled once per instruction set level, the x86 builds
+//! carry a baseline, an SSE4.1, an AVX2 and an AVX-512 version and pick one at
+//! startup.
+//!
+struct KernelTable {
+  IsaLevel level;
+
+  // Side of the square tiles transposed in registers for pixels of 4 and 2
+  // bytes, 0 if the level has no kernel for the pixel size
+  int transpose_tile_32;
+  int transpose_tile_16;
+
+  // Transpose the tiles of the leading w x h pixels of a block that are
+  // multiple of the tile side, strides in pixels. Non-temporal stores require
+  // the rows of out aligned to the tile rows.
+  void (*transpose_tiles_32)(const void *in, size_t in_stride, void *out,
+                             size_t out_stride, int w, int h, bool stream);
+  void (*transpose_tiles_16)(const void *in, size_t in_stride, void *out,
+                             size_t out_stride, int w, int h, bool stream);
+
+  // Split the leading pixels of `count` 8-bit RGB/RGBA pixels to float
+  // planes, or merge them back rounding and saturating, and return the number
+  // of pixels processed, the caller handles the others
+  int (*deinterleave_rgb8)(const uint8_t *in, float *const *planes,
+                           int count);
+  int (*deinterleave_rgba8)(const uint8_t *in, float *const *planes,
+                            int count);
+  int (*interleave_rgb8)(const float *const *planes, uint8_t *out, int count);
+  int (*interleave_rgba8)(const float *const *planes, uint8_t *out,
+                          int count);
+
+  // Convert the leading samples of `count` IEEE 754 binary16 samples to float
+  // or back rounding to nearest even, and return the number of samples
+  // converted, the caller handles the others
+  size_t (*half_to_float)(const uint16_t *in, float *out, size_t count);
+  size_t (*float_to_half)(const float *in, uint16_t *out, size_t count);
+
+  // Multiplies a sorted real DFT of `size` floats by the real parts of the
+  // kernel DFT times scaler
+  void (*spectral_multiply)(float *dft, const float *kernel_dft, size_t size,
+                            float scaler);
+
+  // Rows transformed at once by batched_fft, one per SIMD lane
+  int fft_batch;
+
+  // Real FFT of fft_batch rows of plan.size samples stored sample by sample
+  // (sample n of row l at n * fft_batch + l), the spectra are in the order of
+  // pffft_transform_ordered and stored alike. The backward transform is not
+  // scaled, in, out and work (plan.size * fft_batch floats) must not overlap.
+  // Pruned by [first, last): the forward transform takes the samples out of
+  // it for zeros and the backward one computes the samples in it only, [0,
+  // plan.size) transforms everything.
+  void (*batched_fft)(const BatchedFftPlan &plan, const float *in, float *out,
+                      float *work, bool forward, int first, int last);
+  // spectral_multiply of fft_batch spectra stored sample by sample
+  void (*batched_spectral_multiply)(float *dft, const float *kernel_dft,
+                                    size_t size, float scaler);
+  // Complex FFT of plan.size / 2 points of fft_batch rows, the real parts of
+  // sample n of the rows at n * 2 * fft_batch and their imaginary parts right
+  // after them. Not scaled, in, out and work (plan.size * fft_batch floats)
+  // must not overlap.
+  void (*batched_complex_fft)(const BatchedFftPlan &plan, const float *in,
+                              float *out, float *work, bool forward);
+};
+
+// Kernels of a level, nullptr if not built or not supported by the CPU
+const KernelTable *kernels_for(IsaLevel level);
+
+// Kernels selected at the first call: the highest level supported by the CPU
+// unless the environment variable GAUSSIANBLUR_ISA forces a lower one
+// ("baseline", "sse41", "avx2" or "avx512"), e.g. for benchmarking
+const KernelTable &kernels();
+
+const char *isa_name(IsaLevel level);
+
+}  // namespace gaussianblur
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <gaussianblur/helpers.hpp>
+#include <optional>
+#include <string>
+
+namespace gaussianblur {
+
+enum class MappedFormat {
+  // Headerless interleaved 8-bit samples, the geometry is given by the caller
+  Raw,
+  // Binary PGM (P5), PPM (P6) or PAM (P7) with MAXVAL 255
+  PNM
+};
+
+/**
+ * @brief An image file mapped in memory with mmap.
+ *
+ * The pixels are blurred straight from/to the mapping, avoiding the
+ * decode-copy-copy chain of a regular file read. The input is mapped read-only
+ * unless `writable` is requested, the output is pre-sized with ftruncate and
+ * mapped shared so that the blurred samples land directly in the file. Both
+ * mappings are hinted with MADV_SEQUENTIAL since the (de)interleave passes
+ * walk them front to back.
+ */
+class MappedImage {
+ public:
+  /**
+   * @brief Maps an existing binary PGM/PPM/PAM file.
+   *
+   * @param path The file to map.
+   * @param writable If true, maps the file shared and writable so that it can
+   * be blurred in place.
+   * @return The mapped image or std::nullopt if the file can't be mapped or
+   * the header is not supported.
+   */
+  static std::optional<MappedImage> open(const std::string &path,
+                                         const bool writable = false);
+
+  /**
+   * @brief Maps an existing headerless file of interleaved 8-bit samples.
+   *
+   * @param path The file to map.
+   * @param image_geometry The geometry of the samples stored in the file.
+   * @param writable If true, maps the file shared and writable.
+   * @return The mapped image or std::nullopt if the file can't be mapped or is
+   * smaller than the geometry.
+   */
+  static std::optional<MappedImage> open_raw(const std::string &path,
+                                             const ImgGeom image_geometry,
+                                             const bool writable = false);
+
+  /**
+   * @brief Creates (or truncates) a file pre-sized for the geometry and maps it
+   * writable. For MappedFormat::PNM the header is written as P5 for 1 channel,
+   * P6 for 3 channels and P7 (PAM) otherwise.
+   *
+   * @param path The file to create.
+   * @param image_geometry The geometry of the image to be stored.
+   * @param format The file layout.
+   * @return The mapped image or std::nullopt on failure.
+   */
+  static std::optional<MappedImage> create(const std::string &path,
+                                           const ImgGeom image_geometry,
+                                           const MappedFormat format);
+
+  MappedImage(MappedImage &&other) noexcept;
+  MappedImage &operator=(MappedImage &&other) noexcept;
+  MappedImage(const MappedImage &) = delete;
+  MappedImage &operator=(const MappedImage &) = delete;
+  ~MappedImage();
+
+  const ImgGeom &geom() const { return geometry; }
+  bool writable() const { return is_writable; }
+
+  // First interleaved sample, right after the header if any
+  const uint8_t *pixels() const { return first_pixel; }
+  // Same as pixels() but nullptr if the mapping is read-only
+  uint8_t *mutable_pixels() { return is_writable ? first_pixel : nullptr; }
+
+ private:
+  MappedImage() = default;
+  static std::optional<MappedImage> map(const std::string &path,
+                                        const bool writable,
+                                        const size_t new_size = 0);
+  void unmap();
+
+  void *mapping = nullptr;
+  size_t mapping_size = 0;
+  uint8_t *first_pixel = nullptr;
+  ImgGeom geometry = {0, 0, 0};
+  bool is_writable = false;
+};
+
+/**
+ * @brief Applies Gaussian blur reading from a mapped image and writing to
+ * another one (or to the same one, if mapped writable).
+ *
+ * @param src The mapped source image.
+ * @param dst The mapped destination image, same geometry of src and writable.
+ * @param sigma The smoothing factor for the Gaussian blur.
+ * @param apply_to_alpha If true, applies the blur to the alpha channel too.
+ * @return true on success, false if the mappings are not compatible.
+ */
+bool gaussianblur(const MappedImage &src, MappedImage &dst, const float sigma,
+                  const bool apply_to_alpha);
+
+}  // namespace gaussianblur
@@ -20,9 +20,43 @@ PYBIND11_MODULE(gaussianblur, m) {
         .def_readwrite("data", &Image::data, "The image pixel data.")
         .def_readwrite("geom", &Image::geom, "Geometry information for the image.");
 
+    // Bind the 16-bit and float variants of Image.
+    py::class_<Image16>(m, "Image16", "Image with 16-bit unsigned samples, e.g. medical and astronomy images.")
+        .def(py::init<>(), "Creates an empty Image16 object.")
+        .def_readwrite("data", &Image16::data, "The image pixel data.")
+        .def_readwrite("geom", &Image16::geom, "Geometry information for the image.");
+
+    py::class_<ImageF32>(m, "ImageF32", "Image with float samples, e.g. HDR renders.")
+        .def(py::init<>(), "Creates an empty ImageF32 object.")
+        .def_readwrite("data", &ImageF32::data, "The image pixel data.")
+        .def_readwrite("geom", &ImageF32::geom, "Geometry information for the image.");
+
+    // Bind PlaneStorage enum.
+    py::enum_<gaussianblur::PlaneStorage>(m, "PlaneStorage", "Sample type of the intermediate planes.")
+        .value("Float32", gaussianblur::PlaneStorage::Float32)
+        .value("Float16", gaussianblur::PlaneStorage::Float16)
+        .value("BFloat16", gaussianblur::PlaneStorage::BFloat16);
+
+    // Bind BlurOptions struct.
+    py::class_<gaussianblur::BlurOptions>(m, "BlurOptions", "Options of a blur call: which channels to blur and how.")
+        .def(py::init<>(), "Creates the default options, blurring the color channels only.")
+        .def_readwrite("apply_to_alpha", &gaussianblur::BlurOptions::apply_to_alpha, "Blur the alpha channel too.")
+        .def_readwrite("premultiply_alpha", &gaussianblur::BlurOptions::premultiply_alpha, "Blur with premultiplied alpha, avoiding color fringes.")
+        .def_readwrite("linear_light", &gaussianblur::BlurOptions::linear_light, "Blur in linear light, decoding and re-encoding sRGB.")
+        .def_readwrite("channel_mask", &gaussianblur::BlurOptions::channel_mask, "Bit mask of the channels to blur, 0 to follow apply_to_alpha.")
+        .def_readwrite("intermediate", &gaussianblur::BlurOptions::intermediate, "Sample type of the intermediate planes.")
+        .def_readwrite("lean_memory", &gaussianblur::BlurOptions::lean_memory, "Blur the channels one after the other through a single plane.")
+        .def_readwrite("truncation", &gaussianblur::BlurOptions::truncation, "Ratio to its peak where the Gaussian kernel is truncated, in [0, 1]; 0 picks a step of the samples.");
+
+    m.def("isa_level", []() { return gaussianblur::isa_name(gaussianblur::kernels().level); }, "Instruction set level of the SIMD kernels picked for this CPU: baseline, sse41, avx2 or avx512.");
+
+    m.def("alpha_only_mask", &gaussianblur::alpha_only_mask, "Channel mask selecting the alpha channel of a gray + alpha or RGBA image.", py::arg("channels"));
+
     // Bind the gaussianblur function.
     // This function modifies the Image in place.
-    m.def("gaussianblur", &gaussianblur::gaussianblur,
+    m.def("gaussianblur",
+          static_cast<void (*)(Image &, const float, const bool)>(
+              &gaussianblur::gaussianblur),
           py::arg("image"),
           py::arg("sigma"),
           py::arg("apply_to_alpha"),
@@ -30,4 +64,54 @@ PYBIND11_MODULE(gaussianblur, m) {
           " - image: the image object to be blurred\n"
           " - sigma: standard deviation for the Gaussian kernel\n"
           " - apply_to_alpha: boolean flag to apply the blur to the alpha channel if present");
+    m.def("gaussianblur",
+          static_cast<void (*)(Image16 &, const float, const bool)>(
+              &gaussianblur::gaussianblur),
+          py::arg("image"),
+          py::arg("sigma"),
+          py::arg("apply_to_alpha"),
+          "Applies a Gaussian blur to the provided 16-bit image.");
+    m.def("gaussianblur",
+          static_cast<void (*)(ImageF32 &, const float, const bool)>(
+              &gaussianblur::gaussianblur),
+          py::arg("image"),
+          py::arg("sigma"),
+          py::arg("apply_to_alpha"),
+          "Applies a Gaussian blur to the provided float image.");
+    m.def("gaussianblur",
+          static_cast<void (*)(Image &, const float, const gaussianblur::BlurOptions &)>(
+              &gaussianblur::gaussianblur),
+          py::arg("image"),
+          py::arg("sigma"),
+          py::arg("options"),
+          "Applies a Gaussian blur to the provided image with the given BlurOptions.");
+
+    // Bind the gaussianblur_downscale function.
+    // This function returns a new Image, leaving the source untouched.
+    m.def("gaussianblur_downscale",
+          [](Image &image, const float sigma, const int factor,
+             const gaussianblur::BlurOptions &options) {
+              if (factor < 1) throw py::value_error("factor must be at least 1");
+              Image downscaled;
+              downscaled.geom = {(image.geom.rows + factor - 1) / factor,
+                                 (image.geom.cols + factor - 1) / factor,
+                                 image.geom.channels};
+              downscaled.data.resize((size_t)downscaled.geom.rows *
+                                     downscaled.geom.cols *
+                                     downscaled.geom.channels);
+              gaussianblur::gaussianblur_downscale(
+                  make_view(image), make_view(downscaled), sigma, factor,
+                  options);
+              return downscaled;
+          },
+          py::arg("image"),
+          py::arg("sigma"),
+          py::arg("factor"),
+          py::arg("options"),
+          "Blurs and downscales the provided image by an integer factor in one go, e.g. to anti-alias thumbnails. Parameters:\n"
+          " - image: the image object to be downscaled, left untouched\n"
+          " - sigma: standard deviation for the Gaussian kernel, about factor / 2 removes most of the aliasing\n"
+          " - factor: the downscaling factor, at least 1\n"
+          " - options: the channels to blur and how\n"
+          "Returns a new image of ceil(rows / factor) x ceil(cols / factor) pixels.");
 }
\ No newline at end of file
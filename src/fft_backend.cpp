@@ -0,0 +1,369 @@
+#include <gaussianblur/fft_backend.h>
+#include <gaussianblur/helpers.hpp>
+
+#include <complex>
+extern "C" {
+  #include <pffft_pommier/pffft.h>
+}
+
+namespace gaussianblur {
+
+namespace {
+
+// Whether `size` has no prime factor but 2, 3 and 5 once divided by `unit`
+bool is_5_smooth_multiple(const int size, const int unit) {
+  if (size < unit || size % unit) return false;
+  int R = size / unit;
+  for (const int radix : {5, 3, 2})
+    while (R % radix == 0) R /= radix;
+  return R == 1;
+}
+
+// Custom deleter for PFFFT_Setup
+struct PFFFT_Deleter {
+  void operator()(PFFFT_Setup *setup) const {
+    if (setup) {
+      pffft_destroy_setup(setup);
+    }
+  }
+};
+
+// Define unique_ptr types for PFFFT_Setup with custom deleter
+using PFFFT_Setup_UniquePtr = std::unique_ptr<PFFFT_Setup, PFFFT_Deleter>;
+
+class PffftSetup : public FftSetup {
+ public:
+  PffftSetup(const int size, PFFFT_Setup_UniquePtr setup)
+      : n(size), pffft_setup(std::move(setup)) {}
+
+  int size() const override { return n; }
+  SpectrumLayout layout() const override {
+    return {SpectrumOrder::PackedOrdered, 1};
+  }
+  void forward(const float *in, float *out, float *work) const override {
+    pffft_transform_ordered(pffft_setup.get(), in, out, work, PFFFT_FORWARD);
+  }
+  void backward(const float *in, float *out, float *work) const override {
+    pffft_transform_ordered(pffft_setup.get(), in, out, work, PFFFT_BACKWARD);
+  }
+
+ private:
+  int n;
+  PFFFT_Setup_UniquePtr pffft_setup;
+};
+
+class PffftBackend : public FftBackend {
+ public:
+  const char *name() const override { return "pffft"; }
+  int batch() const override { return 1; }
+  // Utils from pffft to check the nearest efficient transform size of FFT
+  bool is_valid_size(const int size) const override {
+    return is_5_smooth_multiple(size, 32);
+  }
+  int nearest_valid_size(int size) const override {
+    const int N_min = 32;
+    if (size < N_min) size = N_min;
+    size = N_min * ((size + N_min - 1) / N_min);
+
+    while (!is_valid_size(size)) size += N_min;
+    return size;
+  }
+  std::unique_ptr<FftSetup> setup(const int size) const override {
+    if (!is_valid_size(size)) return nullptr;
+    return std::make_unique<PffftSetup>(
+        size, PFFFT_Setup_UniquePtr(pffft_new_setup(size, PFFFT_REAL)));
+  }
+};
+
+class BatchedSetup : public FftSetup {
+ public:
+  BatchedSetup(std::shared_ptr<const BatchedFftSetup> setup,
+               const KernelTable &table)
+      : batched_setup(std::move(setup)), kernel_table(table) {}
+
+  int size() const override { return batched_setup->plan().size; }
+  SpectrumLayout layout() const override {
+    return {SpectrumOrder::PackedOrdered, kernel_table.fft_batch};
+  }
+  void forward(const float *in, float *out, float *work) const override {
+    forward_pruned(in, out, work, 0, size());
+  }
+  void backward(const float *in, float *out, float *work) const override {
+    backward_pruned(in, out, work, 0, size());
+  }
+  void forward_pruned(const float *in, float *out, float *work,
+                      const int first, const int last) const override {
+    kernel_table.batched_fft(batched_setup->plan(), in, out, work, true,
+                             first, last);
+  }
+  void backward_pruned(const float *in, float *out, float *work,
+                       const int first, const int last) const override {
+    kernel_table.batched_fft(batched_setup->plan(), in, out, work, false,
+                             first, last);
+  }
+  // the plan is shared by every level, the narrowest level up to this one
+  // holding the rows is picked, the highest one among equals
+  std::unique_ptr<FftSetup> narrowed(const int rows) const override {
+    const KernelTable *narrowest = &kernel_table;
+    for (const IsaLevel level : {IsaLevel::AVX512, IsaLevel::AVX2,
+                                 IsaLevel::SSE41, IsaLevel::Baseline}) {
+      const KernelTable *table = kernels_for(level);
+      if (level <= kernel_table.level && table && table->fft_batch >= rows &&
+          table->fft_batch < narrowest->fft_batch)
+        narrowest = table;
+    }
+    if (narrowest == &kernel_table) return nullptr;
+    return std::make_unique<BatchedSetup>(batched_setup, *narrowest);
+  }
+
+ private:
+  std::shared_ptr<const BatchedFftSetup> batched_setup;
+  const KernelTable &kernel_table;
+};
+
+class BatchedBackend : public FftBackend {
+ public:
+  const char *name() const override { return "batched"; }
+  int batch() const override { return kernels().fft_batch; }
+  // the complex FFT of half the size needs at least a pass
+  bool is_valid_size(const int size) const override {
+    return size >= 16 && is_5_smooth_multiple(size, 2);
+  }
+  int nearest_valid_size(int size) const override {
+    size = std::max(size + size % 2, 16);
+    while (!is_valid_size(size)) size += 2;
+    return size;
+  }
+  std::unique_ptr<FftSetup> setup(const int size) const override {
+    if (!is_valid_size(size)) return nullptr;
+    return std::make_unique<BatchedSetup>(
+        std::make_shared<const BatchedFftSetup>(size), kernels());
+  }
+};
+
+// exp(-2 pi i j / n) for j < count, products of a coarse and a fine table of
+// about sqrt(count) roots each instead of a cosine and a sine per root
+std::vector<std::complex<double>> unit_roots(const int n, const int count) {
+  auto root = [n](const double j) {
+    return std::polar(1.0, -2 * std::numbers::pi * j / n);
+  };
+  const int fine = std::max(1, (int)std::sqrt((double)count));
+  std::vector<std::complex<double>> fine_roots(fine),
+      coarse_roots((count + fine - 1) / fine), roots(count);
+  for (int j = 0; j < fine; ++j) fine_roots[j] = root(j);
+  for (size_t c = 0; c < coarse_roots.size(); ++c)
+    coarse_roots[c] = root((double)c * fine);
+  for (int j = 0; j < count; ++j)
+    roots[j] = coarse_roots[j / fine] * fine_roots[j % fine];
+  return roots;
+}
+
+//!
+//! \brief Real FFT of a single long row spread over the threads. The complex
+//! FFT of the M = N / 2 points z[n] = x[2n] + i x[2n + 1] is computed on the
+//! M1 x M2 matrix z[n1 * M2 + n2] as the FFTs of its columns, a twiddle
+//! W_M^(n2 k1) per element, and the FFTs of its rows, which leave
+//! Z[k1 + M1 * k2] in row k1 and column k2. The columns, then the rows are
+//! gathered fft_batch at a time into the batched FFT, whose groups run on
+//! hybrid_loop, and the real spectrum is split from Z like the batched FFT
+//! does.
+//!
+class FourStepSetup : public FftSetup {
+ public:
+  FourStepSetup(const int size, const int rows)
+      : n(size),
+        points(size / 2),
+        M1(rows),
+        M2(points / rows),
+        column_fft(2 * M1),
+        row_fft(2 * M2) {
+    // the twiddles stored like the matrix they multiply
+    const std::vector<std::complex<double>> roots = unit_roots(points, points);
+    twiddles.resize((size_t)2 * points);
+    for (int k1 = 0; k1 < M1; ++k1)
+      for (int n2 = 0; n2 < M2; ++n2) {
+        const std::complex<double> w = roots[(int64_t)k1 * n2 % points];
+        twiddles[2 * ((size_t)k1 * M2 + n2)] = w.real();
+        twiddles[2 * ((size_t)k1 * M2 + n2) + 1] = w.imag();
+      }
+    for (const std::complex<double> w : unit_roots(n, points / 2 + 1))
+      split.emplace_back(w);
+  }
+
+  int size() const override { return n; }
+  SpectrumLayout layout() const override {
+    return {SpectrumOrder::PackedOrdered, 1};
+  }
+  bool is_parallel() const override { return true; }
+
+  void forward(const float *in, float *out, float *work) const override {
+    column_ffts(in, work, true);
+    row_ffts(work, out, true);
+    // DC and Nyquist terms in the first pair, like pffft
+    std::complex<float> *const z = (std::complex<float> *)out;
+    z[0] = {z[0].real() + z[0].imag(), z[0].real() - z[0].imag()};
+    split_loop([&](const int k) {
+      const std::complex<float> a = z[k], b = std::conj(z[points - k]);
+      const std::complex<float> even = (a + b) * 0.5F,
+                                odd = (a - b) * std::complex<float>(0, -0.5F),
+                                t = odd * split[k];
+      z[points - k] = std::conj(even - t);
+      z[k] = even + t;
+    });
+  }
+
+  void backward(const float *in, float *out, float *work) const override {
+    const std::complex<float> *const x = (const std::complex<float> *)in;
+    std::complex<float> *const z = (std::complex<float> *)work;
+    z[0] = {x[0].real() + x[0].imag(), x[0].real() - x[0].imag()};
+    split_loop([&](const int k) {
+      const std::complex<float> a = x[k], b = std::conj(x[points - k]);
+      const std::complex<float> even = a + b,
+                                t = (a - b) * std::conj(split[k]);
+      const std::complex<float> i_t = {-t.imag(), t.real()};
+      z[points - k] = std::conj(even - i_t);
+      z[k] = even + i_t;
+    });
+    // the columns are gathered before being written back, in place
+    column_ffts(work, work, false);
+    row_ffts(work, out, false);
+  }
+
+ private:
+  // The pairs of bins k and M - k, 0 < k <= M / 2, in blocks over the threads
+  template <typename op>
+  void split_loop(op operation) const {
+    constexpr int block = 4096;
+    const int last = points / 2;
+    hybrid_loop((last + block - 1) / block, [&](auto b) {
+      const int end = std::min(last, (b + 1) * block);
+      for (int k = b * block + 1; k <= end; ++k) operation(k);
+    });
+  }
+
+  // FFTs of the M2 columns of z in src, times the twiddles, to the same
+  // columns of dst
+  void column_ffts(const float *src, float *dst, const bool forward) const {
+    const KernelTable &k = kernels();
+    const int B = k.fft_batch, lane_floats = 2 * B;
+    const int groups = M2 / B;
+    const int threads = std::min(hybrid_loop_threads(), groups);
+    std::vector<AlignedVector<float>> buffers(threads);
+    for (auto &buffer : buffers) buffer.resize((size_t)3 * M1 * lane_floats);
+
+    hybrid_loop(groups, [&](auto g, const int tid) {
+      float *const signal = buffers.at(tid).data(),
+                   *const spectrum = signal + (size_t)M1 * lane_floats,
+                   *const work = spectrum + (size_t)M1 * lane_floats;
+      const size_t column = (size_t)g * B;
+      for (int n1 = 0; n1 < M1; ++n1) {
+        const float *const z = src + 2 * (n1 * (size_t)M2 + column);
+        float *const s = signal + (size_t)n1 * lane_floats;
+        for (int l = 0; l < B; ++l) {
+          s[l] = z[2 * l];
+          s[B + l] = z[2 * l + 1];
+        }
+      }
+      k.batched_complex_fft(column_fft.plan(), signal, spectrum, work,
+                            forward);
+      for (int k1 = 0; k1 < M1; ++k1) {
+        const float *const s = spectrum + (size_t)k1 * lane_floats;
+        const float *const w = twiddles.data() + 2 * (k1 * (size_t)M2 + column);
+        float *const t = dst + 2 * (k1 * (size_t)M2 + column);
+        for (int l = 0; l < B; ++l) {
+          const float wr = w[2 * l],
+                      wi = forward ? w[2 * l + 1] : -w[2 * l + 1];
+          t[2 * l] = s[l] * wr - s[B + l] * wi;
+          t[2 * l + 1] = s[l] * wi + s[B + l] * wr;
+        }
+      }
+    });
+  }
+
+  // FFTs of the M1 rows of the matrix in src, to Z in dst
+  void row_ffts(const float *src, float *dst, const bool forward) const {
+    const KernelTable &k = kernels();
+    const int B = k.fft_batch, lane_floats = 2 * B;
+    const int groups = M1 / B;
+    const int threads = std::min(hybrid_loop_threads(), groups);
+    std::vector<AlignedVector<float>> buffers(threads);
+    for (auto &buffer : buffers) buffer.resize((size_t)3 * M2 * lane_floats);
+
+    hybrid_loop(groups, [&](auto g, const int tid) {
+      float *const signal = buffers.at(tid).data(),
+                   *const spectrum = signal + (size_t)M2 * lane_floats,
+                   *const work = spectrum + (size_t)M2 * lane_floats;
+      const size_t row = (size_t)g * B;
+      for (int l = 0; l < B; ++l) {
+        const float *const t = src + 2 * (row + l) * M2;
+        for (int n2 = 0; n2 < M2; ++n2) {
+          signal[(size_t)n2 * lane_floats + l] = t[2 * n2];
+          signal[(size_t)n2 * lane_floats + B + l] = t[2 * n2 + 1];
+        }
+      }
+      k.batched_complex_fft(row_fft.plan(), signal, spectrum, work, forward);
+      for (int k2 = 0; k2 < M2; ++k2) {
+        const float *const s = spectrum + (size_t)k2 * lane_floats;
+        float *const z = dst + 2 * (k2 * (size_t)M1 + row);
+        for (int l = 0; l < B; ++l) {
+          z[2 * l] = s[l];
+          z[2 * l + 1] = s[B + l];
+        }
+      }
+    });
+  }
+
+  int n, points, M1, M2;
+  BatchedFftSetup column_fft, row_fft;
+  AlignedVector<float> twiddles;
+  // exp(-2 pi i k / n), k <= n / 4
+  AlignedVector<std::complex<float>> split;
+};
+
+class FourStepBackend : public FftBackend {
+ public:
+  const char *name() const override { return "four-step"; }
+  int batch() const override { return 1; }
+  // M1 and M2 multiple of 16, the widest batch of the kernels
+  bool is_valid_size(const int size) const override {
+    return is_5_smooth_multiple(size, 512);
+  }
+  int nearest_valid_size(int size) const override {
+    const int N_min = 512;
+    size = N_min * (std::max(size + N_min - 1, N_min) / N_min);
+    while (!is_valid_size(size)) size += N_min;
+    return size;
+  }
+  std::unique_ptr<FftSetup> setup(const int size) const override {
+    if (!is_valid_size(size)) return nullptr;
+    // the most square matrix, 16 x 16 blocks of (size / 512) = a * b
+    const int blocks = size / 512;
+    int a = 1;
+    for (int d = 1; d * d <= blocks; ++d)
+      if (blocks % d == 0) a = d;
+    return std::make_unique<FourStepSetup>(size, 16 * a);
+  }
+};
+
+}  // namespace
+
+const FftBackend &pffft_backend() {
+  static const PffftBackend backend;
+  return backend;
+}
+
+const FftBackend &batched_fft_backend() {
+  static const BatchedBackend backend;
+  return backend;
+}
+
+const FftBackend &four_step_fft_backend() {
+  static const FourStepBackend backend;
+  return backend;
+}
+
+const FftBackend &default_fft_backend() {
+  return kernels().fft_batch > 4 ? batched_fft_backend() : pffft_backend();
+}
+
+}  // namespace gaussianblur
@@ -1,19 +1,21 @@
-
 #include <gaussianblur/gaussianblur.h>
 #include <gaussianblur/helpers.hpp>
+#include <cstring>
+#include <limits>
 #include <numbers>
-extern "C" {
-  #include <pffft_pommier/pffft.h>
-}
 
 namespace gaussianblur {
 
-int gaussian_window(const float sigma, const int max_width = 0) {
-  // calculate the width necessary for the provided sigma
+int gaussian_window(const float sigma, const int max_width = 0,
+                    const float truncation = 1.0F / 255) {
+  // calculate the width necessary for the provided sigma, truncating the
+  // gaussian where it falls to `truncation` times its peak, in (0, 1]
   // return an odd width for the kernel, if max is passed check that is not
   // bigger than it
 
-  const float radius = std::max(sigma * sqrt(2 * log(255)) - 1, 0.0);
+  const float radius =
+      std::max(sigma * sqrt(2 * std::max(0.0, log(1.0 / truncation))) - 1,
+               0.0);
   int width = radius * 2 + 0.5F;
   if (max_width) width = std::min(width, max_width);
 
@@ -59,50 +61,65 @@ void get_gaussian(T &kernel, const float sigma, int width = 0,
   }
 }
 
-template <typename T, typename N>
-void pffft_sorted_optimized_convolution(std::vector<T, N> &tile_dft,
-                                        const std::vector<T, N> &kernel_dft,
-                                        float scaler) {
+// Transposes h rows of w floats to out, the SIMD tiles first and then the
+// leftover samples
+void transpose_rows(const float *in, float *out, const int w, const int h) {
+  const KernelTable &k = kernels();
+  k.transpose_tiles_32(in, w, out, h, w, h, false);
+  const int tile = std::max(k.transpose_tile_32, 1);
+  const int tiled_w = w / tile * tile, tiled_h = h / tile * tile;
+  for (int y = 0; y < h; ++y)
+    for (int x = y < tiled_h ? tiled_w : 0; x < w; ++x)
+      out[(size_t)x * h + y] = in[(size_t)y * w + x];
+}
+
+void spectral_convolution(float *tile_dft, const SpectrumLayout layout,
+                          const AlignedVector<float> &kernel_dft,
+                          float scaler) {
   // Do the convolution in the frequency domain without accumulation.
   // Assuming that:
-  //   - the DFT obtained from pffft is **sorted** in the conventional way
+  //   - the DFT is **sorted** in the conventional way (PackedOrdered)
   //   - imaginary part of the centered kernel is 0, which is our case (skip
   //   multiplication for imaginay part of the kernel)
-  for (int i = 0; i < tile_dft.size() / 2; i++) {
-    const int real_part_idx = 2 * i;
-    const int imag_part_idx = 2 * i + 1;
-    const float real_part_kernel_multiplier =
-        kernel_dft.at(real_part_idx) * scaler;
-    tile_dft.at(real_part_idx) *= real_part_kernel_multiplier;
-    tile_dft.at(imag_part_idx) *= real_part_kernel_multiplier;
-  }
+  const KernelTable &k = kernels();
+  const size_t size = kernel_dft.size();
+  if (layout.batch == 1)
+    k.spectral_multiply(tile_dft, kernel_dft.data(), size, scaler);
+  else if (layout.batch == k.fft_batch)
+    k.batched_spectral_multiply(tile_dft, kernel_dft.data(), size, scaler);
+  else
+    for (size_t i = 0; i < size; ++i)
+      for (int l = 0; l < layout.batch; ++l)
+        tile_dft[i * layout.batch + l] *=
+            kernel_dft[i == 1 ? 1 : i & ~(size_t)1] * scaler;
 }
 
-// Utils from pffft to check the nearest efficient transform size of FFT
-int is_valid_size(int N) {
-  const int N_min = 32;
-  int R = N;
-  while (R >= 5 * N_min && (R % 5) == 0) R /= 5;
-  while (R >= 3 * N_min && (R % 3) == 0) R /= 3;
-  while (R >= 2 * N_min && (R % 2) == 0) R /= 2;
-  return (R == N_min) ? 1 : 0;
-}
-
-int nearest_transform_size(int N) {
-  const int N_min = 32;
-  if (N < N_min) N = N_min;
-  N = N_min * ((N + N_min - 1) / N_min);
-
-  while (!is_valid_size(N)) N += N_min;
-  return N;
+// Spectrum of the kernel centered in setup.size() samples, a single row
+// whatever the batch of the setup
+AlignedVector<float> kernel_spectrum(const FftSetup &setup, const float sigma,
+                                     const int kSize) {
+  const int size = setup.size(), batch = setup.layout().batch;
+  // create a gaussian 1D kernel with the specified sigma and kernel size, and
+  // center it in a length of FFT_length
+  AlignedVector<float> kernel(size);
+  get_gaussian(kernel, sigma, kSize, size);
+
+  AlignedVector<float> signal((size_t)size * batch), spectrum(signal.size()),
+      work(signal.size());
+  for (int n = 0; n < size; ++n) signal[(size_t)n * batch] = kernel[n];
+  setup.forward(signal.data(), spectrum.data(), work.data());
+  for (int n = 0; n < size; ++n) kernel[n] = spectrum[(size_t)n * batch];
+  return kernel;
 }
 
-KernelDFT prepare_kernel_DFT(const ImgGeom image_geometry, const float sigma) {
+KernelDFT prepare_kernel_DFT(const ImgGeom image_geometry, const float sigma,
+                             const FftBackend &backend,
+                             const float truncation) {
   std::chrono::time_point<std::chrono::steady_clock> start_0 =
       std::chrono::steady_clock::now();
   // calculate a good width of the kernel for our sigma
   int kSize = gaussian_window(
-      sigma, std::max(image_geometry.rows, image_geometry.cols));
+      sigma, std::max(image_geometry.rows, image_geometry.cols), truncation);
 
   int pad = (kSize - 1) / 2;
 
@@ -110,52 +127,72 @@ KernelDFT prepare_kernel_DFT(const ImgGeom image_geometry, const float sigma) {
   std::array<int, 2> sizes = {image_geometry.rows + pad * 2,
                               image_geometry.cols + pad * 2};
 
-  // if the length of the data is not decomposable in small prime numbers 2 - 3
-  // - 5, is necessary to update the size adding more pad as trailing zeros
+  // short padded tiles (icons, thumbnails) may be laid end to end in a longer
+  // transform, the reflected pads of a tile are as wide as the kernel radius
+  // and keep its neighbours out of its convolution. The count per transform is
+  // the one of lowest estimated cost, N log2 N per row of a call plus a fixed
+  // cost per call: packing saves the calls and the rounding of tiny sizes of
+  // pffft, while a batched call already runs many short tiles at once.
+  constexpr int packed_tile_limit = 64, packed_fft_length = 256,
+                call_cost = 256;
+  const int batch = backend.batch();
+  const std::array<int, 2> tiles = {image_geometry.cols, image_geometry.rows};
+  std::array<int, 2> tiles_per_fft = {1, 1};
+  for (int i = 0; i < 2; ++i) {
+    if (sizes.at(i) >= packed_tile_limit) continue;
+    const int max_tiles =
+        std::clamp(packed_fft_length / sizes.at(i), 1, tiles.at(i));
+    double lowest_cost = std::numeric_limits<double>::max();
+    for (int count = 1; count <= max_tiles; ++count) {
+      const int n = backend.nearest_valid_size(sizes.at(i) * count);
+      const int ffts = (tiles.at(i) + count - 1) / count;
+      const int calls = (ffts + batch - 1) / batch;
+      const double cost = calls * (batch * n * std::log2(n) + call_cost);
+      if (cost < lowest_cost) {
+        lowest_cost = cost;
+        tiles_per_fft.at(i) = count;
+      }
+    }
+    sizes.at(i) *= tiles_per_fft.at(i);
+  }
+
+  // long rows fewer than the threads (line scans, 1D signals) leave cores
+  // idle, each of their transforms is spread over the threads instead. Fewer
+  // than the lanes of the backend they leave lanes idle too, and a batched FFT
+  // of long rows streams all the lanes through memory at each pass while the
+  // four-step one works on cache-sized columns and rows: 1 x 1M floats blur
+  // in 238 ms against 690 ms on a single AVX-512 core, 8 x 1M in 555 against
+  // 923 ms, the batched FFT catching up at 16 rows.
+  constexpr int four_step_min_size = 1 << 15;
+  std::array<const FftBackend *, 2> backends = {&backend, &backend};
+  for (int i = 0; i < 2; ++i)
+    if ((tiles.at(i) < hybrid_loop_threads() || tiles.at(i) < batch) &&
+        sizes.at(i) >= four_step_min_size)
+      backends.at(i) = &four_step_fft_backend();
+
+  // if the length of the data is not a valid size of the backend (e.g. not
+  // decomposable in small prime numbers 2 - 3 - 5), is necessary to update the
+  // size adding more pad as trailing zeros
   std::array<int, 2> trailing_zeros = {0, 0};
 
   for (int i = 0; i < 2; ++i) {
-    if (!is_valid_size(sizes.at(i))) {
-      int new_size = nearest_transform_size(sizes.at(i));
+    if (!backends.at(i)->is_valid_size(sizes.at(i))) {
+      int new_size = backends.at(i)->nearest_valid_size(sizes.at(i));
       trailing_zeros.at(i) = (new_size - sizes.at(i));
       sizes.at(i) = new_size;
     }
   }
 
-  // fast convolve by pffft, without reordering the z-domain. Thus, we perform a
-  // row by row, col by col FFT and convolution with 2x1D kernel
-
-  AlignedVector<float> kernel_aligned_1D_col(sizes.at(1));
-
-  // create a gaussian 1D kernel with the specified sigma and kernel size, and
-  // center it in a length of FFT_length
-  get_gaussian(kernel_aligned_1D_col, sigma, kSize, sizes.at(1));
-
-  AlignedVector<float> kerf_1D_col(sizes.at(1));
-  AlignedVector<float> kerf_1D_row(sizes.at(0));
-
-  PFFFT_Setup_UniquePtr cols_setup(pffft_new_setup(sizes.at(1), PFFFT_REAL));
-  PFFFT_Setup_UniquePtr rows_setup(pffft_new_setup(sizes.at(0), PFFFT_REAL));
-
-  AlignedVector<float> tmp;
-  const int maxsize = std::max(sizes.at(0), sizes.at(1));
-  tmp.reserve(maxsize);
-  tmp.resize(sizes.at(1));
-
-  pffft_transform_ordered(cols_setup.get(), kernel_aligned_1D_col.data(),
-                          kerf_1D_col.data(), tmp.data(), PFFFT_FORWARD);
+  // fast convolve row by row, col by col with 2x1D kernel
+  std::unique_ptr<FftSetup> cols_setup = backends.at(1)->setup(sizes.at(1));
+  std::unique_ptr<FftSetup> rows_setup = backends.at(0)->setup(sizes.at(0));
 
+  AlignedVector<float> kerf_1D_col = kernel_spectrum(*cols_setup, sigma, kSize);
   // calculate the DFT of kernel by col if size of cols is not the same of rows
-  if (sizes.at(0) != sizes.at(1)) {
-    AlignedVector<float> kernel_aligned_1D_row(sizes.at(0));
-    get_gaussian(kernel_aligned_1D_row, sigma, kSize, sizes.at(0));
-
-    tmp.resize(sizes.at(0));
-    pffft_transform_ordered(rows_setup.get(), kernel_aligned_1D_row.data(),
-                            kerf_1D_row.data(), tmp.data(), PFFFT_FORWARD);
-
-  } else
-    std::copy(kerf_1D_col.begin(), kerf_1D_col.end(), kerf_1D_row.begin());
+  AlignedVector<float> kerf_1D_row =
+      sizes.at(0) != sizes.at(1) || backends.at(0) != backends.at(1)
+          ? kernel_spectrum(*rows_setup, sigma, kSize)
+          : kerf_1D_col;
 
 #ifdef TIMING
   printf("Kernel DFT prepared in %f ms\n",
@@ -168,116 +205,411 @@ KernelDFT prepare_kernel_DFT(const ImgGeom image_geometry, const float sigma) {
           std::move(rows_setup),
           std::move(cols_setup),
           pad,
-          TrailingZeros{trailing_zeros.at(0), trailing_zeros.at(1)}};
-}
-
-std::optional<DeinterleavedChs> deinterleave_image_channels(Image &image) {
-  DeinterleavedChs deinterleaved_vector;
-
-  int img_size_per_channel = image.geom.rows * image.geom.cols;
-  if (image.geom.channels == 3) {
-    deinterleaved_vector =
-        DeinterleavedChs(3, std::vector<float>(img_size_per_channel));
-    std::array<float *, 3> BGR = {deinterleaved_vector.at(0).data(),
-                                  deinterleaved_vector.at(1).data(),
-                                  deinterleaved_vector.at(2).data()};
-    deinterleave_channels<3>(image.data.data(), BGR.data(),
-                             image.geom.rows * image.geom.cols);
-  } else if (image.geom.channels == 4) {
-    deinterleaved_vector =
-        DeinterleavedChs(4, std::vector<float>(img_size_per_channel));
-    std::array<float *, 4> BGRA = {
-        deinterleaved_vector.at(0).data(), deinterleaved_vector.at(1).data(),
-        deinterleaved_vector.at(2).data(), deinterleaved_vector.at(3).data()};
-    deinterleave_channels<4>(image.data.data(), BGRA.data(),
-                             image.geom.rows * image.geom.cols);
-  } else {
+          TrailingZeros{trailing_zeros.at(0), trailing_zeros.at(1)},
+          TilesPerFFT{tiles_per_fft.at(0), tiles_per_fft.at(1)}};
+}
+
+// Alpha value of a fully opaque pixel: the max of integer samples, 1 for float
+template <typename T>
+constexpr float opaque_alpha() {
+  return std::is_integral_v<T> ? std::numeric_limits<T>::max() : 1.0F;
+}
+
+// Truncation of the kernel of a blur of T samples: the one of the options, or
+// a step of the integer samples (16-bit for float) if 0
+template <typename T>
+float kernel_truncation(const BlurOptions &options) {
+  if (options.truncation > 0) return options.truncation;
+  return 1.0F / (sizeof(T) == 1 ? 255 : 65535);
+}
+
+template <uint32_t Channels, typename T>
+void deinterleave_planes(const BasicImageView<T> &src, float **planes,
+                         const BlurOptions &options) {
+  const ImgGeom &geom = src.geom;
+  auto deinterleave = [&](const auto &block_op) {
+    if (src.is_contiguous())
+      deinterleave_channels<Channels>(
+          src.data, planes, (size_t)geom.rows * geom.cols, block_op);
+    else
+      deinterleave_channels_strided(src.data, planes, geom.rows, geom.cols,
+                                    Channels, src.row_stride,
+                                    src.pixel_stride, src.channel_stride,
+                                    block_op);
+  };
+
+  // the linearization and the premultiplication are fused in the
+  // deinterleave of each block, colors are linearized before being weighted
+  auto premultiply = [&](const auto &block_op) {
+    if constexpr (Channels == 2 || Channels == 4) {
+      if (options.premultiply_alpha) {
+        deinterleave(chain_block_ops(
+            block_op, PremultiplyAlpha<Channels>{opaque_alpha<T>()}));
+        return;
+      }
+    }
+    deinterleave(block_op);
+  };
+  if (options.linear_light)
+    premultiply(SrgbToLinear<Channels>{opaque_alpha<T>(),
+                                       std::is_same_v<T, uint8_t>});
+  else
+    premultiply(NoBlockOp{});
+}
+
+template <typename T>
+std::optional<DeinterleavedChs> deinterleave_image_channels(
+    const BasicImageView<T> &src, const BlurOptions &options) {
+  const ImgGeom &geom = src.geom;
+  if (geom.channels <= 0) {
     std::cerr << "Unsupported number of channels" << std::endl;
     return std::nullopt;
   }
 
+  const size_t img_size_per_channel = (size_t)geom.rows * geom.cols;
+  DeinterleavedChs deinterleaved_vector(geom.channels);
+  for (auto &plane : deinterleaved_vector) plane.resize(img_size_per_channel);
+  std::vector<float *> planes(geom.channels);
+  for (int c = 0; c < geom.channels; ++c)
+    planes.at(c) = deinterleaved_vector.at(c).data();
+
+  if (geom.channels == 1)
+    deinterleave_planes<1>(src, planes.data(), options);
+  else if (geom.channels == 2)
+    deinterleave_planes<2>(src, planes.data(), options);
+  else if (geom.channels == 3)
+    deinterleave_planes<3>(src, planes.data(), options);
+  else if (geom.channels == 4)
+    deinterleave_planes<4>(src, planes.data(), options);
+  else if (!src.is_contiguous())
+    deinterleave_channels_strided(src.data, planes.data(), geom.rows,
+                                  geom.cols, geom.channels, src.row_stride,
+                                  src.pixel_stride, src.channel_stride);
+  else
+    deinterleave_channels(src.data, planes.data(), img_size_per_channel,
+                          geom.channels);
+
   return std::optional<DeinterleavedChs>{std::move(deinterleaved_vector)};
 }
 
-void process_channel_tiles(
-    const int channel, const int tiles, const int tile_size, const int pad,
-    const int trailing_zeros, PFFFT_Setup *setup,
-    const AlignedVector<float> &kernel, AlignedVector<float> &tmp,
-    AlignedVector<float> &tile, AlignedVector<float> &work,
-    AlignedVector<float> &resf, DeinterleavedChs &deinterleaved_channels,
-    float scaler) {
-  tmp.resize(kernel.size());
-  tile.resize(kernel.size());
-  work.resize(kernel.size());
-  hybrid_loop(tiles, [&](auto j) {
-    auto tmp_local(tmp), tile_local(tile), work_local(work);
-
-    // copy the tile and pad by reflection in the aligned vector
-    // left reflected pad
-    std::copy_n(
-        std::reverse_iterator(deinterleaved_channels.at(channel).data() +
-                              j * tile_size + pad + 1),
-        pad, tile_local.begin());
-    // middle
-    std::copy_n(deinterleaved_channels.at(channel).data() + j * tile_size,
-                tile_size, tile_local.begin() + pad);
-    // right reflected pad
-    std::copy_n(
-        std::reverse_iterator(deinterleaved_channels.at(channel).data() +
-                              (j + 1) * tile_size - 1),
-        pad, tile_local.end() - pad /* fft trailing 0s --> */ - trailing_zeros);
-
-    pffft_transform_ordered(setup, tile_local.data(), work_local.data(),
-                            tmp_local.data(), PFFFT_FORWARD);
-    pffft_sorted_optimized_convolution(work_local, kernel, scaler);
-    pffft_transform_ordered(setup, work_local.data(), tile_local.data(),
-                            tmp_local.data(), PFFFT_BACKWARD);
+// Gray + alpha and RGB + alpha images blur the alpha channel on request only
+// (always if premultiplied), any other layout (gray, RGB, multispectral) blurs
+// every channel. A channel_mask overrides both, except for premultiplied alpha.
+std::vector<int> channels_to_process(const int channels,
+                                     const BlurOptions &options) {
+  const bool has_alpha = channels == 2 || channels == 4;
+  std::vector<int> selected;
+  for (int c = 0; c < channels; ++c) {
+    bool blur = !has_alpha || options.apply_to_alpha || c < channels - 1;
+    if (has_alpha && options.premultiply_alpha)
+      blur = true;
+    else if (options.channel_mask)
+      blur = c < 32 && (options.channel_mask >> c & 1U);
+    if (blur) selected.push_back(c);
+  }
+  return selected;
+}
+
+// Whether the views share some bytes, strides are assumed non-negative
+template <typename T>
+bool views_overlap(const BasicImageView<T> &a, const BasicImageView<T> &b) {
+  auto extent = [](const BasicImageView<T> &view) {
+    const uint8_t *first = (const uint8_t *)view.data;
+    return std::make_pair(
+        first, first + (view.geom.rows - 1) * view.row_stride +
+                   (view.geom.cols - 1) * view.pixel_stride +
+                   (view.geom.channels - 1) * view.channel_stride + sizeof(T));
+  };
+  const auto [a_first, a_last] = extent(a);
+  const auto [b_first, b_last] = extent(b);
+  return a_first < b_last && b_first < a_last;
+}
+
+template <typename T>
+bool same_view(const BasicImageView<T> &a, const BasicImageView<T> &b) {
+  return a.data == b.data && a.row_stride == b.row_stride &&
+         a.pixel_stride == b.pixel_stride &&
+         a.channel_stride == b.channel_stride;
+}
+
+template <typename T>
+T *channel_origin(const BasicImageView<T> &view, const int channel) {
+  return (T *)((uint8_t *)view.data + channel * view.channel_stride);
+}
+
+// The color channels are sRGB encoded, alpha and multispectral bands are not
+bool is_color_channel(const int channel, const int channels) {
+  return channels <= 4 &&
+         !((channels == 2 || channels == 4) && channel == channels - 1);
+}
+
+// Gathers a single channel with a strided pass
+template <typename T>
+void deinterleave_channel(const BasicImageView<T> &src, const int channel,
+                          float *plane, const BlurOptions &options) {
+  const ImgGeom &geom = src.geom;
+  float *planes[1] = {plane};
+  auto deinterleave = [&](const auto &block_op) {
+    deinterleave_channels_strided(channel_origin(src, channel), planes,
+                                  geom.rows, geom.cols, 1, src.row_stride,
+                                  src.pixel_stride, src.channel_stride,
+                                  block_op);
+  };
+  if (options.linear_light && is_color_channel(channel, geom.channels))
+    deinterleave(
+        SrgbToLinear<1>{opaque_alpha<T>(), std::is_same_v<T, uint8_t>});
+  else
+    deinterleave(NoBlockOp{});
+}
+
+// Gathers the selected channels only, one strided pass per plane, leaving the
+// planes of the other channels empty
+template <typename T>
+DeinterleavedChs deinterleave_selected_channels(
+    const BasicImageView<T> &src, const std::vector<int> &selected,
+    const BlurOptions &options) {
+  DeinterleavedChs deinterleaved_vector(src.geom.channels);
+  for (const int c : selected) {
+    deinterleaved_vector.at(c).resize((size_t)src.geom.rows * src.geom.cols);
+    deinterleave_channel(src, c, deinterleaved_vector.at(c).data(), options);
+  }
+  return deinterleaved_vector;
+}
+
+// Index of sample i of a signal of `size` samples extended by reflection
+// without repeating the borders (OpenCV's BORDER_REFLECT_101)
+int reflect_101(int i, const int size) {
+  if (size == 1) return 0;
+  const int period = 2 * (size - 1);
+  i = std::abs(i) % period;
+  return i < size ? i : period - i;
+}
+
+// Convolves every tile (row) of the plane, converting it to float32 in the
+// FFT buffers only, then transposes the results stored in resf. A transform
+// holds tiles_per_fft padded tiles end to end and a batched setup transforms
+// a group of them at once, one per lane. The last group runs through the
+// narrowed setup if there is one, the lanes past the last tile being zeros.
+// Every step-th sample of each result is kept only, from the first.
+template <typename In, typename Out, typename Dst>
+void process_channel_tiles(const In *plane, Out *resf, Dst *transposed,
+                           const int tiles, const int tile_size, const int pad,
+                           const int trailing_zeros, const int tiles_per_fft,
+                           const FftSetup &setup,
+                           const AlignedVector<float> &kernel, float scaler,
+                           const int step = 1) {
+  const size_t fft_size = kernel.size();
+  const int padded_size = tile_size + 2 * pad;
+  const int out_size = (tile_size + step - 1) / step;
+  const int batch = setup.layout().batch;
+  const int ffts = (tiles + tiles_per_fft - 1) / tiles_per_fft;
+  const int groups = (ffts + batch - 1) / batch;
+  // e.g. a single row on AVX-512 transformed by 4 lanes rather than 16
+  const int last_ffts = ffts - (groups - 1) * batch;
+  const std::unique_ptr<FftSetup> narrowed =
+      last_ffts < batch ? setup.narrowed(last_ffts) : nullptr;
+
+  // FFT buffers of each thread of the loop below, a parallel setup runs the
+  // groups one after the other
+  const bool parallel = setup.is_parallel();
+  const int threads = parallel ? 1 : std::min(hybrid_loop_threads(), groups);
+  std::vector<AlignedVector<float>> tmp(threads), tile(threads),
+      work(threads);
+  for (int tid = 0; tid < threads; ++tid) {
+    tmp.at(tid).resize(fft_size * batch);
+    tile.at(tid).resize(fft_size * batch);
+    work.at(tid).resize(fft_size * batch);
+  }
+
+  // tiles of the l-th transform of a group
+  auto fft_tiles = [&](const int g, const int l) {
+    return std::clamp(tiles - (g * batch + l) * tiles_per_fft, 0,
+                      tiles_per_fft);
+  };
+
+  auto process_group = [&](const int g, const int tid) {
+    float *const tmp_local = tmp.at(tid).data(),
+                 *const tile_local = tile.at(tid).data(),
+                 *const work_local = work.at(tid).data();
+    const FftSetup &group_setup =
+        g == groups - 1 && narrowed ? *narrowed : setup;
+    const SpectrumLayout group_layout = group_setup.layout();
+    const int lanes = group_layout.batch;
+
+    for (int l = 0; l < lanes; ++l) {
+      const int first = (g * batch + l) * tiles_per_fft;
+      const int count = fft_tiles(g, l);
+      float *const fft_row = tile_local + l * fft_size;
+      for (int t = 0; t < count; ++t) {
+        const In *const row = plane + (size_t)(first + t) * tile_size;
+        float *const tile_row = fft_row + t * padded_size;
+        // copy the tile and pad by reflection in the aligned vector
+        // middle
+        convert_n(row, tile_size, tile_row + pad);
+        if (pad < tile_size) {
+          // left reflected pad
+          std::copy_n(std::reverse_iterator(row + pad + 1), pad, tile_row);
+          // right reflected pad
+          std::copy_n(std::reverse_iterator(row + tile_size - 1), pad,
+                      tile_row + pad + tile_size);
+        } else {
+          // pads wider than the tile (e.g. the columns of a single row)
+          // reflect it back and forth
+          for (int p = 1; p <= pad; ++p) {
+            tile_row[pad - p] = tile_row[pad + reflect_101(-p, tile_size)];
+            tile_row[pad + tile_size - 1 + p] =
+                tile_row[pad + reflect_101(tile_size - 1 + p, tile_size)];
+          }
+        }
+      }
+      // the backward transform of the previous tiles overwrote the trailing
+      // 0s
+      std::fill(fft_row + count * padded_size, fft_row + fft_size, 0.0F);
+    }
+
+    // a batch is interleaved sample by sample, a transform per lane
+    float *const signal = lanes > 1 ? tmp_local : tile_local;
+    if (lanes > 1) transpose_rows(tile_local, signal, fft_size, lanes);
+    float *const scratch = lanes > 1 ? tile_local : tmp_local;
+    // the trailing zeros and the pads of the result are pruned
+    group_setup.forward_pruned(signal, work_local, scratch, 0,
+                               fft_size - trailing_zeros);
+    spectral_convolution(work_local, group_layout, kernel, scaler);
+    group_setup.backward_pruned(work_local, signal, scratch, pad,
+                                fft_size - trailing_zeros - pad);
+    if (lanes > 1) transpose_rows(signal, tile_local, lanes, fft_size);
 
     // save the 1st pass tile per tile in the output vector
-    std::copy_n(tile_local.begin() + pad, tile_size,
-                resf.begin() + j * tile_size);
-  });
+    for (int l = 0; l < lanes; ++l) {
+      const int first = (g * batch + l) * tiles_per_fft;
+      const int count = fft_tiles(g, l);
+      for (int t = 0; t < count; ++t) {
+        const float *const result =
+            tile_local + l * fft_size + t * padded_size + pad;
+        Out *const out = resf + (size_t)(first + t) * out_size;
+        if (step == 1)
+          convert_n(result, tile_size, out);
+        else
+          for (int j = 0; j < out_size; ++j) out[j] = result[(size_t)j * step];
+      }
+    }
+  };
+  if (parallel)
+    for (int g = 0; g < groups; ++g) process_group(g, 0);
+  else
+    hybrid_loop(groups, process_group);
 
   // transpose cache-friendly, took from FastBoxBlur
-  flip_block<1>(resf.data(), deinterleaved_channels.at(channel).data(),
-                tile_size, tiles);
+  flip_block<1>(resf, transposed, out_size, tiles);
 }
 
-void pffft(const ImgGeom image_geometry, const KernelDFT kernelDFT,
-           DeinterleavedChs &deinterleaved_channels, bool apply_to_alpha) {
+// Backend of the options or the default one
+const FftBackend &fft_backend(const BlurOptions &options) {
+  return options.fft_backend ? *options.fft_backend : default_fft_backend();
+}
+
+// Bytes of an intermediate sample
+size_t storage_size(const PlaneStorage storage) {
+  return storage == PlaneStorage::Float32 ? sizeof(float) : sizeof(uint16_t);
+}
+
+// Blurs a plane in place: row pass, transpose, column pass, transpose back.
+// The results of each pass (in scratch if given, of at least the plane size in
+// Storage samples) and the transposed plane are stored as Storage, the latter
+// in the bytes of the plane itself that is dead after the row pass. A factor
+// keeps every factor-th row and column of the blur in the leading samples of
+// the plane: the row pass keeps the decimated columns only, the column pass
+// and the transposes then run on a plane factor times narrower.
+template <typename Storage>
+void blur_plane(float *plane, const ImgGeom image_geometry,
+                const KernelDFT &kernelDFT, void *scratch,
+                const int factor = 1) {
+  UninitializedVector<Storage> own_scratch(
+      scratch ? 0 : (size_t)image_geometry.rows * image_geometry.cols);
+  Storage *resf = scratch ? (Storage *)scratch : own_scratch.data();
+  Storage *transposed = (Storage *)plane;
+
+  // Process the convolution row per row and transpose the result
+  process_channel_tiles(plane, resf, transposed, image_geometry.rows,
+                        image_geometry.cols, kernelDFT.pad,
+                        kernelDFT.trailing_zeros.cols,
+                        kernelDFT.tiles_per_fft.cols, *kernelDFT.cols_setup,
+                        kernelDFT.kerf_1D_col,
+                        1.0F / kernelDFT.kerf_1D_col.size(), factor);
+
+  // Process the convolution col per col and transpose the result
+  process_channel_tiles((const Storage *)transposed, resf, plane,
+                        (image_geometry.cols + factor - 1) / factor,
+                        image_geometry.rows, kernelDFT.pad,
+                        kernelDFT.trailing_zeros.rows,
+                        kernelDFT.tiles_per_fft.rows, *kernelDFT.rows_setup,
+                        kernelDFT.kerf_1D_row,
+                        1.0F / kernelDFT.kerf_1D_row.size(), factor);
+}
+
+// Keeps every factor-th row and column of a plane in its leading
+// ceil(rows / factor) x ceil(cols / factor) samples
+void decimate_plane(float *plane, const ImgGeom image_geometry,
+                    const int factor) {
+  const int rows = (image_geometry.rows + factor - 1) / factor,
+            cols = (image_geometry.cols + factor - 1) / factor;
+  for (int y = 0; y < rows; ++y)
+    for (int x = 0; x < cols; ++x)
+      plane[(size_t)y * cols + x] =
+          plane[(size_t)y * factor * image_geometry.cols + (size_t)x * factor];
+}
+
+// Blurs the planes of the given channels. A scratch buffer of a plane of
+// intermediate samples, if given, is shared by the channels that then run one
+// after the other. A factor decimates the blurred planes (see blur_plane).
+void pffft(const ImgGeom image_geometry, const KernelDFT &kernelDFT,
+           DeinterleavedChs &deinterleaved_channels,
+           const std::vector<int> &channels, const BlurOptions &options,
+           void *scratch = nullptr, const int factor = 1) {
   std::chrono::time_point<std::chrono::steady_clock> start_1 =
       std::chrono::steady_clock::now();
-  const int maxsize =
-      std::max(kernelDFT.kerf_1D_row.size(), kernelDFT.kerf_1D_col.size());
-  const float divisor_col = 1.0F / kernelDFT.kerf_1D_col.size();
-  const float divisor_row = 1.0F / kernelDFT.kerf_1D_row.size();
-
-  AlignedVector<float> tmp;
-  tmp.reserve(maxsize);
-
-  int ch_to_process = 3;
-  if (image_geometry.channels == 4 && apply_to_alpha) ch_to_process = 4;
-
-  for (int i = 0; i < ch_to_process; ++i) {
-    AlignedVector<float> resf(image_geometry.rows * image_geometry.cols);
-    AlignedVector<float> tile, work;
-    tile.reserve(maxsize);
-    work.reserve(maxsize);
-
-    // Process the convolution row per row and transpose the result
-    process_channel_tiles(i, image_geometry.rows, image_geometry.cols,
-                          kernelDFT.pad, kernelDFT.trailing_zeros.cols,
-                          kernelDFT.cols_setup.get(), kernelDFT.kerf_1D_col,
-                          tmp, tile, work, resf, deinterleaved_channels,
-                          divisor_col);
-
-    // Process the convolution col per col and transpose the result
-    process_channel_tiles(i, image_geometry.cols, image_geometry.rows,
-                          kernelDFT.pad, kernelDFT.trailing_zeros.rows,
-                          kernelDFT.rows_setup.get(), kernelDFT.kerf_1D_row,
-                          tmp, tile, work, resf, deinterleaved_channels,
-                          divisor_row);
+  // Constant planes (e.g. an opaque alpha) are their own blur (decimated or
+  // not) and identical
+  // planes (e.g. gray stored as RGB) take the blur of the first one, the
+  // checks bail out at the first differing sample of ordinary planes
+  const size_t plane_size = (size_t)image_geometry.rows * image_geometry.cols;
+  std::vector<int> selected;
+  std::vector<std::pair<int, int>> duplicates;
+  for (const int c : channels) {
+    const float *plane = deinterleaved_channels.at(c).data();
+    if (is_constant_plane(plane, plane_size)) continue;
+    const auto same = std::find_if(
+        selected.begin(), selected.end(), [&](const int other) {
+          return std::memcmp(deinterleaved_channels.at(other).data(), plane,
+                             plane_size * sizeof(float)) == 0;
+        });
+    if (same != selected.end())
+      duplicates.emplace_back(*same, c);
+    else
+      selected.push_back(c);
   }
+  const int ch_to_process = selected.size();
+
+  auto process_channel = [&](const int selected_idx) {
+    float *plane = deinterleaved_channels.at(selected.at(selected_idx)).data();
+    if (options.intermediate == PlaneStorage::Float16)
+      blur_plane<Float16>(plane, image_geometry, kernelDFT, scratch, factor);
+    else if (options.intermediate == PlaneStorage::BFloat16)
+      blur_plane<BFloat16>(plane, image_geometry, kernelDFT, scratch, factor);
+    else
+      blur_plane<float>(plane, image_geometry, kernelDFT, scratch, factor);
+  };
+
+  // With at least a channel per thread (e.g. multispectral cubes) the channels
+  // run in parallel and their tiles serially, otherwise the channels run one
+  // after the other with their tiles in parallel
+  if (!scratch && ch_to_process >= hybrid_loop_threads() && ch_to_process > 1)
+    hybrid_loop(ch_to_process, process_channel);
+  else
+    for (int i = 0; i < ch_to_process; ++i) process_channel(i);
+
+  for (const auto &[original, duplicate] : duplicates)
+    deinterleaved_channels.at(duplicate) = deinterleaved_channels.at(original);
 #ifdef TIMING
   printf("Convolution done in %f ms\n",
          std::chrono::duration<double, std::milli>(
@@ -286,41 +618,331 @@ void pffft(const ImgGeom image_geometry, const KernelDFT kernelDFT,
 #endif
 }
 
-void copy_processed_data_to_image(
-    Image &image, const DeinterleavedChs deinterleaved_channels) {
-  if (image.geom.channels == 3) {
-    std::array<const float *, 3> BGR = {deinterleaved_channels.at(0).data(),
-                                        deinterleaved_channels.at(1).data(),
-                                        deinterleaved_channels.at(2).data()};
-    interleave_channels<3>(BGR.data(), image.data.data(),
-                           image.geom.rows * image.geom.cols);
-  } else if (image.geom.channels == 4) {
-    std::array<const float *, 4> BGRA = {deinterleaved_channels.at(0).data(),
-                                         deinterleaved_channels.at(1).data(),
-                                         deinterleaved_channels.at(2).data(),
-                                         deinterleaved_channels.at(3).data()};
-    interleave_channels<4>(BGRA.data(), image.data.data(),
-                           image.geom.rows * image.geom.cols);
+template <uint32_t Channels, typename T>
+void interleave_planes(const BasicImageView<T> &dst, float **planes,
+                       const BlurOptions &options) {
+  const ImgGeom &geom = dst.geom;
+  auto interleave = [&](const auto &block_op) {
+    if (dst.is_contiguous())
+      interleave_channels<Channels>(
+          planes, dst.data, (size_t)geom.rows * geom.cols, block_op);
+    else
+      interleave_channels_strided(planes, dst.data, geom.rows, geom.cols,
+                                  Channels, dst.row_stride, dst.pixel_stride,
+                                  dst.channel_stride, block_op);
+  };
+
+  // the division by alpha and the sRGB encoding are fused in the interleave
+  // of each block, in the reverse order of deinterleave_planes
+  auto unpremultiply = [&](const auto &block_op) {
+    if constexpr (Channels == 2 || Channels == 4) {
+      if (options.premultiply_alpha) {
+        constexpr float opaque = opaque_alpha<T>();
+        interleave(chain_block_ops(
+            UnpremultiplyAlpha<Channels>{
+                opaque, std::is_integral_v<T>
+                            ? opaque
+                            : std::numeric_limits<float>::max()},
+            block_op));
+        return;
+      }
+    }
+    interleave(block_op);
+  };
+  if (options.linear_light)
+    unpremultiply(LinearToSrgb<Channels>{opaque_alpha<T>(),
+                                         std::is_same_v<T, uint8_t>});
+  else
+    unpremultiply(NoBlockOp{});
+}
+
+template <typename T>
+void copy_processed_data_to_image(const BasicImageView<T> &dst,
+                                  DeinterleavedChs deinterleaved_channels,
+                                  const BlurOptions &options) {
+  const ImgGeom &geom = dst.geom;
+  const size_t img_size_per_channel = (size_t)geom.rows * geom.cols;
+  std::vector<float *> planes(geom.channels);
+  for (int c = 0; c < geom.channels; ++c)
+    planes.at(c) = deinterleaved_channels.at(c).data();
+
+  if (geom.channels == 1)
+    interleave_planes<1>(dst, planes.data(), options);
+  else if (geom.channels == 2)
+    interleave_planes<2>(dst, planes.data(), options);
+  else if (geom.channels == 3)
+    interleave_planes<3>(dst, planes.data(), options);
+  else if (geom.channels == 4)
+    interleave_planes<4>(dst, planes.data(), options);
+  else if (!dst.is_contiguous())
+    interleave_channels_strided(planes.data(), dst.data, geom.rows, geom.cols,
+                                geom.channels, dst.row_stride,
+                                dst.pixel_stride, dst.channel_stride);
+  else
+    interleave_channels(planes.data(), dst.data, img_size_per_channel,
+                        geom.channels);
+}
+
+// Copies a channel that is not blurred from src to a distinct dst
+template <typename T>
+void copy_channel(const BasicImageView<T> &src, const BasicImageView<T> &dst,
+                  const int channel) {
+  const T *const src_channel = channel_origin(src, channel);
+  T *const dst_channel = channel_origin(dst, channel);
+  hybrid_loop(dst.geom.rows, [&](auto y) {
+    const uint8_t *src_sample =
+        (const uint8_t *)src_channel + y * src.row_stride;
+    uint8_t *dst_sample = (uint8_t *)dst_channel + y * dst.row_stride;
+    for (int x = 0; x < dst.geom.cols; ++x, src_sample += src.pixel_stride,
+             dst_sample += dst.pixel_stride)
+      *(T *)dst_sample = *(const T *)src_sample;
+  });
+}
+
+// Scatters a single plane with a strided pass
+template <typename T>
+void interleave_channel(const BasicImageView<T> &dst, const int channel,
+                        float *plane, const BlurOptions &options) {
+  const ImgGeom &geom = dst.geom;
+  float *planes[1] = {plane};
+  auto interleave = [&](const auto &block_op) {
+    interleave_channels_strided(planes, channel_origin(dst, channel),
+                                geom.rows, geom.cols, 1, dst.row_stride,
+                                dst.pixel_stride, dst.channel_stride,
+                                block_op);
+  };
+  if (options.linear_light && is_color_channel(channel, geom.channels))
+    interleave(LinearToSrgb<1>{opaque_alpha<T>(), std::is_same_v<T, uint8_t>});
+  else
+    interleave(NoBlockOp{});
+}
+
+// Scatters the selected planes only, the other channels of dst keep their
+// samples when blurring in place and are copied from src otherwise
+template <typename T>
+void copy_selected_channels_to_image(const BasicImageView<T> &src,
+                                     const BasicImageView<T> &dst,
+                                     DeinterleavedChs deinterleaved_channels,
+                                     const BlurOptions &options) {
+  const bool in_place = same_view(src, dst);
+  for (int c = 0; c < dst.geom.channels; ++c) {
+    UninitializedVector<float> &plane = deinterleaved_channels.at(c);
+    if (!plane.empty())
+      interleave_channel(dst, c, plane.data(), options);
+    else if (!in_place)
+      copy_channel(src, dst, c);
+  }
+}
+
+// Blurs the selected channels one after the other, each one gathered in the
+// same plane and transformed with the same scratch buffer
+template <typename T>
+void blur_channels_one_by_one(const BasicImageView<T> &src,
+                              const BasicImageView<T> &dst,
+                              const std::vector<int> &selected,
+                              const float sigma, const BlurOptions &options) {
+  const ImgGeom &geom = src.geom;
+  const size_t plane_size = (size_t)geom.rows * geom.cols;
+  const bool in_place = same_view(src, dst);
+  DeinterleavedChs planes(geom.channels);
+  UninitializedVector<float> plane, scratch;
+  std::optional<KernelDFT> kernelDFT;
+  if (!selected.empty()) {
+    plane.resize(plane_size);
+    scratch.resize((plane_size * storage_size(options.intermediate) +
+                    sizeof(float) - 1) /
+                   sizeof(float));
+    kernelDFT = prepare_kernel_DFT(geom, sigma, fft_backend(options),
+                                   kernel_truncation<T>(options));
+  }
+
+  for (int c = 0; c < geom.channels; ++c) {
+    if (std::find(selected.begin(), selected.end(), c) == selected.end()) {
+      if (!in_place) copy_channel(src, dst, c);
+      continue;
+    }
+    planes.at(c).swap(plane);
+    deinterleave_channel(src, c, planes.at(c).data(), options);
+    pffft(geom, kernelDFT.value(), planes, {c}, options, scratch.data());
+    interleave_channel(dst, c, planes.at(c).data(), options);
+    planes.at(c).swap(plane);
   }
 }
 
-void gaussianblur(Image &image, const float sigma, const bool apply_to_alpha) {
-  // If the image has the alpha channel, the convolution is done on the 4th
-  // channel if alpha is true, otherwise on the first 3 channels only
+// Installs the allocator and an allocation tracker of the options on the
+// calling thread for the duration of a blur call, reporting the high-water
+// mark to BlurOptions::stats
+class AllocationScope {
+ public:
+  explicit AllocationScope(const BlurOptions &options)
+      : stats(options.stats), previous(allocation_context) {
+    allocation_context.allocator = options.allocator;
+    if (stats) allocation_context.tracker = &tracker;
+  }
+  ~AllocationScope() {
+    if (stats) stats->peak_bytes = tracker.peak;
+    allocation_context = previous;
+  }
+
+ private:
+  BlurStats *stats;
+  AllocationContext previous;
+  AllocationTracker tracker;
+};
+
+template <typename T>
+void gaussianblur(const BasicImageView<T> &src, const BasicImageView<T> &dst,
+                  const float sigma, const BlurOptions &options) {
+  // If the image has the alpha channel (gray + alpha or RGBA), the convolution
+  // is done on it if apply_to_alpha is true, otherwise on the color channels
+  // only
   if (sigma <= 0) {
     printf("Invalid smoothing factor\n");
     return;
   }
+  // 0 picks the default, NaN fails both comparisons
+  if (!(options.truncation >= 0 && options.truncation <= 1)) {
+    printf("Invalid truncation of the kernel\n");
+    return;
+  }
+  if (!src.data || !dst.data || src.geom.rows <= 0 || src.geom.cols <= 0 ||
+      src.geom.rows != dst.geom.rows || src.geom.cols != dst.geom.cols ||
+      src.geom.channels != dst.geom.channels) {
+    std::cerr << "Invalid or mismatching image views" << std::endl;
+    return;
+  }
+  if (src.geom.channels <= 0) {
+    std::cerr << "Unsupported number of channels" << std::endl;
+    return;
+  }
+  AllocationScope allocation_scope(options);
+
+  // 16-bit samples exceed the range of half floats
+  BlurOptions blur_options = options;
+  if (std::is_same_v<T, uint16_t> &&
+      blur_options.intermediate == PlaneStorage::Float16)
+    blur_options.intermediate = PlaneStorage::Float32;
+
+  // Channels gathered one at a time (lean memory), or only the selected ones
+  // when at most half of the channels are blurred (e.g. the alpha of a drop
+  // shadow), unless the destination partially overlaps the source and has to
+  // wait for every sample to be read
+  const std::vector<int> selected =
+      channels_to_process(src.geom.channels, blur_options);
+  const bool separate_channels =
+      same_view(src, dst) || !views_overlap(src, dst);
+  if (blur_options.lean_memory && !blur_options.premultiply_alpha &&
+      separate_channels) {
+    blur_channels_one_by_one(src, dst, selected, sigma, blur_options);
+    return;
+  }
+  if ((int)selected.size() * 2 <= src.geom.channels && separate_channels) {
+    DeinterleavedChs selected_channels =
+        deinterleave_selected_channels(src, selected, blur_options);
+    if (!selected.empty()) {
+      const KernelDFT kernelDFT =
+          prepare_kernel_DFT(src.geom, sigma, fft_backend(blur_options),
+                             kernel_truncation<T>(blur_options));
+      pffft(src.geom, kernelDFT, selected_channels, selected, blur_options);
+    }
+    copy_selected_channels_to_image(src, dst, std::move(selected_channels),
+                                    blur_options);
+    return;
+  }
+
   std::optional<DeinterleavedChs> deinterleaved_channels;
-  if (!(deinterleaved_channels = deinterleave_image_channels(image))
+  if (!(deinterleaved_channels =
+             deinterleave_image_channels(src, blur_options))
            .has_value())
     return;
 
-  KernelDFT kernelDFT = prepare_kernel_DFT(image.geom, sigma);
-  pffft(image.geom, std::move(kernelDFT), deinterleaved_channels.value(),
-        apply_to_alpha);
+  const KernelDFT kernelDFT =
+      prepare_kernel_DFT(src.geom, sigma, fft_backend(blur_options),
+                         kernel_truncation<T>(blur_options));
+  pffft(src.geom, kernelDFT, deinterleaved_channels.value(), selected,
+        blur_options);
 
-  copy_processed_data_to_image(image,
-                               std::move(deinterleaved_channels.value()));
+  copy_processed_data_to_image(
+      dst, std::move(deinterleaved_channels.value()), blur_options);
 }
+
+template <typename T>
+void gaussianblur_downscale(const BasicImageView<T> &src,
+                            const BasicImageView<T> &dst, const float sigma,
+                            const int factor, const BlurOptions &options) {
+  if (sigma <= 0 || factor < 1) {
+    printf("Invalid smoothing or downscaling factor\n");
+    return;
+  }
+  if (!(options.truncation >= 0 && options.truncation <= 1)) {
+    printf("Invalid truncation of the kernel\n");
+    return;
+  }
+  if (!src.data || !dst.data || src.geom.rows <= 0 || src.geom.cols <= 0 ||
+      dst.geom.rows != (src.geom.rows + factor - 1) / factor ||
+      dst.geom.cols != (src.geom.cols + factor - 1) / factor ||
+      src.geom.channels != dst.geom.channels) {
+    std::cerr << "Invalid or mismatching image views" << std::endl;
+    return;
+  }
+  if (src.geom.channels <= 0) {
+    std::cerr << "Unsupported number of channels" << std::endl;
+    return;
+  }
+  AllocationScope allocation_scope(options);
+
+  // 16-bit samples exceed the range of half floats
+  BlurOptions blur_options = options;
+  if (std::is_same_v<T, uint16_t> &&
+      blur_options.intermediate == PlaneStorage::Float16)
+    blur_options.intermediate = PlaneStorage::Float32;
+
+  // the whole source is read before the destination is written
+  std::optional<DeinterleavedChs> deinterleaved_channels;
+  if (!(deinterleaved_channels =
+            deinterleave_image_channels(src, blur_options))
+           .has_value())
+    return;
+
+  const std::vector<int> selected =
+      channels_to_process(src.geom.channels, blur_options);
+  if (!selected.empty()) {
+    const KernelDFT kernelDFT =
+        prepare_kernel_DFT(src.geom, sigma, fft_backend(blur_options),
+                           kernel_truncation<T>(blur_options));
+    pffft(src.geom, kernelDFT, deinterleaved_channels.value(), selected,
+          blur_options, nullptr, factor);
+  }
+  // the channels that are not blurred are decimated alone
+  for (int c = 0; c < src.geom.channels; ++c)
+    if (std::find(selected.begin(), selected.end(), c) == selected.end())
+      decimate_plane(deinterleaved_channels.value().at(c).data(), src.geom,
+                     factor);
+
+  copy_processed_data_to_image(
+      dst, std::move(deinterleaved_channels.value()), blur_options);
+}
+
+// Supported sample types
+template void gaussianblur(const BasicImageView<uint8_t> &,
+                           const BasicImageView<uint8_t> &, const float,
+                           const BlurOptions &);
+template void gaussianblur(const BasicImageView<uint16_t> &,
+                           const BasicImageView<uint16_t> &, const float,
+                           const BlurOptions &);
+template void gaussianblur(const BasicImageView<float> &,
+                           const BasicImageView<float> &, const float,
+                           const BlurOptions &);
+template void gaussianblur_downscale(const BasicImageView<uint8_t> &,
+                                     const BasicImageView<uint8_t> &,
+                                     const float, const int,
+                                     const BlurOptions &);
+template void gaussianblur_downscale(const BasicImageView<uint16_t> &,
+                                     const BasicImageView<uint16_t> &,
+                                     const float, const int,
+                                     const BlurOptions &);
+template void gaussianblur_downscale(const BasicImageView<float> &,
+                                     const BasicImageView<float> &,
+                                     const float, const int,
+                                     const BlurOptions &);
 }  // namespace gaussianblur
@@ -0,0 +1,102 @@
+#include <gaussianblur/kernels.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+
+namespace gaussianblur {
+
+namespace baseline {
+extern const KernelTable table;
+}
+#if defined(GAUSSIANBLUR_X86_DISPATCH)
+namespace sse41 {
+extern const KernelTable table;
+}
+namespace avx2 {
+extern const KernelTable table;
+}
+namespace avx512 {
+extern const KernelTable table;
+}
+#endif
+
+namespace {
+
+constexpr IsaLevel levels[] = {IsaLevel::Baseline, IsaLevel::SSE41,
+                               IsaLevel::AVX2, IsaLevel::AVX512};
+
+bool cpu_supports(const IsaLevel level) {
+#if defined(GAUSSIANBLUR_X86_DISPATCH)
+  __builtin_cpu_init();
+  const bool sse41 = __builtin_cpu_supports("sse4.1");
+  if (level == IsaLevel::SSE41) return sse41;
+  const bool avx2 = sse41 && __builtin_cpu_supports("avx2") &&
+                    __builtin_cpu_supports("fma") &&
+                    __builtin_cpu_supports("f16c");
+  if (level == IsaLevel::AVX2) return avx2;
+  if (level == IsaLevel::AVX512)
+    return avx2 && __builtin_cpu_supports("avx512f") &&
+           __builtin_cpu_supports("avx512bw") &&
+           __builtin_cpu_supports("avx512vl");
+#endif
+  return level == IsaLevel::Baseline;
+}
+
+const KernelTable &select_kernels() {
+  IsaLevel selected = IsaLevel::Baseline;
+  for (const IsaLevel level : levels)
+    if (kernels_for(level)) selected = level;
+
+  const char *forced = std::getenv("GAUSSIANBLUR_ISA");
+  if (forced && *forced) {
+    const IsaLevel *level =
+        std::find_if(std::begin(levels), std::end(levels), [&](IsaLevel l) {
+          return std::strcmp(isa_name(l), forced) == 0;
+        });
+    if (level == std::end(levels))
+      std::cerr << "Unknown GAUSSIANBLUR_ISA " << forced << ", using "
+                << isa_name(selected) << std::endl;
+    else if (!kernels_for(*level))
+      std::cerr << "GAUSSIANBLUR_ISA " << forced
+                << " not supported by this CPU or build, using "
+                << isa_name(selected) << std::endl;
+    else
+      selected = *level;
+  }
+  return *kernels_for(selected);
+}
+
+}  // namespace
+
+const KernelTable *kernels_for(const IsaLevel level) {
+  if (!cpu_supports(level)) return nullptr;
+#if defined(GAUSSIANBLUR_X86_DISPATCH)
+  if (level == IsaLevel::SSE41) return &sse41::table;
+  if (level == IsaLevel::AVX2) return &avx2::table;
+  if (level == IsaLevel::AVX512) return &avx512::table;
+#endif
+  return &baseline::table;
+}
+
+const KernelTable &kernels() {
+  static const KernelTable &selected = select_kernels();
+  return selected;
+}
+
+const char *isa_name(const IsaLevel level) {
+  switch (level) {
+    case IsaLevel::SSE41:
+      return "sse41";
+    case IsaLevel::AVX2:
+      return "avx2";
+    case IsaLevel::AVX512:
+      return "avx512";
+    default:
+      return "baseline";
+  }
+}
+
+}  // namespace gaussianblur
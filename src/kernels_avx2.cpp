@@ -0,0 +1,4 @@
+// Kernels built with -mavx2 -mfma -mf16c, selected on the CPUs supporting them
+#define GAUSSIANBLUR_KERNELS_NAMESPACE avx2
+#define GAUSSIANBLUR_KERNELS_LEVEL IsaLevel::AVX2
+#include "kernels_impl.hpp"
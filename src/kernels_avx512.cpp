@@ -0,0 +1,5 @@
+// Kernels built with -mavx512f -mavx512bw -mavx512vl on top of the AVX2 flags,
+// selected on the CPUs supporting them
+#define GAUSSIANBLUR_KERNELS_NAMESPACE avx512
+#define GAUSSIANBLUR_KERNELS_LEVEL IsaLevel::AVX512
+#include "kernels_impl.hpp"
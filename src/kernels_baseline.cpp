@@ -0,0 +1,5 @@
+// Kernels built with the flags of the library, the only ones on non-x86
+// targets
+#define GAUSSIANBLUR_KERNELS_NAMESPACE baseline
+#define GAUSSIANBLUR_KERNELS_LEVEL IsaLevel::Baseline
+#include "kernels_impl.hpp"
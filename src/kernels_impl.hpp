@@ -0,0 +1,848 @@
+// Kernels of kernels.h, included once per instruction set level by a
+// translation unit compiled with the flags of the level after defining
+// GAUSSIANBLUR_KERNELS_NAMESPACE and GAUSSIANBLUR_KERNELS_LEVEL. Everything
+// but the table has internal linkage and no standard template is used, so
+// that no code built for a level leaks to the callers of another one.
+
+#include <gaussianblur/kernels.h>
+
+#include <cstring>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace gaussianblur {
+namespace GAUSSIANBLUR_KERNELS_NAMESPACE {
+namespace {
+
+// Side of the SIMD tiles transposing pixels of `pixel_bytes` in registers, 0
+// if there is no kernel for the pixel size
+constexpr int transpose_tile_size(const size_t pixel_bytes) {
+#if defined(__AVX__)
+  if (pixel_bytes == 4) return 8;
+#elif defined(__SSE2__) || defined(__wasm_simd128__) || defined(__aarch64__)
+  if (pixel_bytes == 4) return 4;
+#endif
+#if defined(__SSE2__)
+  if (pixel_bytes == 2) return 8;
+#endif
+  return 0;
+}
+
+//!
+//! \brief Transposes a tile of transpose_tile_size(PixelBytes) pixels of 2 or
+//! 4 bytes (e.g. float and half float planes, RGBA8 pixels) in registers.
+//!
+//! \param[in] in           first pixel of the tile
+//! \param[in] in_stride    pixels between two rows of in
+//! \param[out] out         first pixel of the transposed tile
+//! \param[in] out_stride   pixels between two rows of out
+//! \param[in] stream       non-temporal stores, the rows of out must be
+//!                         aligned to the tile row size
+//!
+template <size_t PixelBytes>
+void transpose_tile(const void *in, const size_t in_stride, void *out,
+                           const size_t out_stride, const bool stream) {
+  if constexpr (PixelBytes == 4) {
+    const float *src = (const float *)in;
+    float *dst = (float *)out;
+#if defined(__AVX__)
+    __m256 r[8], t[8];
+    for (int i = 0; i < 8; ++i) r[i] = _mm256_loadu_ps(src + i * in_stride);
+    for (int i = 0; i < 8; i += 2) {
+      t[i] = _mm256_unpacklo_ps(r[i], r[i + 1]);
+      t[i + 1] = _mm256_unpackhi_ps(r[i], r[i + 1]);
+    }
+    for (int i = 0; i < 8; i += 4) {
+      r[i] = _mm256_shuffle_ps(t[i], t[i + 2], _MM_SHUFFLE(1, 0, 1, 0));
+      r[i + 1] = _mm256_shuffle_ps(t[i], t[i + 2], _MM_SHUFFLE(3, 2, 3, 2));
+      r[i + 2] = _mm256_shuffle_ps(t[i + 1], t[i + 3], _MM_SHUFFLE(1, 0, 1, 0));
+      r[i + 3] = _mm256_shuffle_ps(t[i + 1], t[i + 3], _MM_SHUFFLE(3, 2, 3, 2));
+    }
+    for (int i = 0; i < 4; ++i) {
+      t[i] = _mm256_permute2f128_ps(r[i], r[i + 4], 0x20);
+      t[i + 4] = _mm256_permute2f128_ps(r[i], r[i + 4], 0x31);
+    }
+    for (int i = 0; i < 8; ++i)
+      if (stream)
+        _mm256_stream_ps(dst + i * out_stride, t[i]);
+      else
+        _mm256_storeu_ps(dst + i * out_stride, t[i]);
+#elif defined(__SSE2__)
+    __m128 r0 = _mm_loadu_ps(src), r1 = _mm_loadu_ps(src + in_stride),
+           r2 = _mm_loadu_ps(src + 2 * in_stride),
+           r3 = _mm_loadu_ps(src + 3 * in_stride);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    const __m128 rows[4] = {r0, r1, r2, r3};
+    for (int i = 0; i < 4; ++i)
+      if (stream)
+        _mm_stream_ps(dst + i * out_stride, rows[i]);
+      else
+        _mm_storeu_ps(dst + i * out_stride, rows[i]);
+#elif defined(__wasm_simd128__)
+    const v128_t r0 = wasm_v128_load(src), r1 = wasm_v128_load(src + in_stride),
+                 r2 = wasm_v128_load(src + 2 * in_stride),
+                 r3 = wasm_v128_load(src + 3 * in_stride);
+    const v128_t t0 = wasm_i32x4_shuffle(r0, r1, 0, 4, 1, 5),
+                 t1 = wasm_i32x4_shuffle(r0, r1, 2, 6, 3, 7),
+                 t2 = wasm_i32x4_shuffle(r2, r3, 0, 4, 1, 5),
+                 t3 = wasm_i32x4_shuffle(r2, r3, 2, 6, 3, 7);
+    wasm_v128_store(dst, wasm_i64x2_shuffle(t0, t2, 0, 2));
+    wasm_v128_store(dst + out_stride, wasm_i64x2_shuffle(t0, t2, 1, 3));
+    wasm_v128_store(dst + 2 * out_stride, wasm_i64x2_shuffle(t1, t3, 0, 2));
+    wasm_v128_store(dst + 3 * out_stride, wasm_i64x2_shuffle(t1, t3, 1, 3));
+#elif defined(__aarch64__)
+    const float32x4x2_t t01 =
+        vtrnq_f32(vld1q_f32(src), vld1q_f32(src + in_stride));
+    const float32x4x2_t t23 = vtrnq_f32(vld1q_f32(src + 2 * in_stride),
+                                        vld1q_f32(src + 3 * in_stride));
+    vst1q_f32(dst, vcombine_f32(vget_low_f32(t01.val[0]),
+                                vget_low_f32(t23.val[0])));
+    vst1q_f32(dst + out_stride, vcombine_f32(vget_low_f32(t01.val[1]),
+                                             vget_low_f32(t23.val[1])));
+    vst1q_f32(dst + 2 * out_stride, vcombine_f32(vget_high_f32(t01.val[0]),
+                                                 vget_high_f32(t23.val[0])));
+    vst1q_f32(dst + 3 * out_stride, vcombine_f32(vget_high_f32(t01.val[1]),
+                                                 vget_high_f32(t23.val[1])));
+#endif
+  } else if constexpr (PixelBytes == 2) {
+#if defined(__SSE2__)
+    const uint16_t *src = (const uint16_t *)in;
+    uint16_t *dst = (uint16_t *)out;
+    __m128i r[8], t[8];
+    for (int i = 0; i < 8; ++i)
+      r[i] = _mm_loadu_si128((const __m128i *)(src + i * in_stride));
+    for (int i = 0; i < 8; i += 2) {
+      t[i] = _mm_unpacklo_epi16(r[i], r[i + 1]);
+      t[i + 1] = _mm_unpackhi_epi16(r[i], r[i + 1]);
+    }
+    for (int i = 0; i < 8; i += 4) {
+      r[i] = _mm_unpacklo_epi32(t[i], t[i + 2]);
+      r[i + 1] = _mm_unpackhi_epi32(t[i], t[i + 2]);
+      r[i + 2] = _mm_unpacklo_epi32(t[i + 1], t[i + 3]);
+      r[i + 3] = _mm_unpackhi_epi32(t[i + 1], t[i + 3]);
+    }
+    for (int i = 0; i < 4; ++i) {
+      t[2 * i] = _mm_unpacklo_epi64(r[i], r[i + 4]);
+      t[2 * i + 1] = _mm_unpackhi_epi64(r[i], r[i + 4]);
+    }
+    for (int i = 0; i < 8; ++i)
+      if (stream)
+        _mm_stream_si128((__m128i *)(dst + i * out_stride), t[i]);
+      else
+        _mm_storeu_si128((__m128i *)(dst + i * out_stride), t[i]);
+#endif
+  }
+}
+
+// Byte shuffles between 4 interleaved RGB/RGBA 8-bit pixels and 4 samples
+// per channel (channel-major), -1 zeroing the byte
+template <uint32_t Channels>
+struct ChannelShuffles {
+  // samples of channel c in the low 4 bytes
+  alignas(16) int8_t gather[Channels][16];
+  // channel-major samples (4 per channel) back to interleaved pixels
+  alignas(16) int8_t scatter[16];
+};
+
+template <uint32_t Channels>
+constexpr ChannelShuffles<Channels> channel_shuffles() {
+  ChannelShuffles<Channels> shuffles{};
+  for (uint32_t c = 0; c < Channels; ++c)
+    for (uint32_t i = 0; i < 16; ++i)
+      shuffles.gather[c][i] = i < 4 ? c + i * Channels : -1;
+  for (uint32_t i = 0; i < 16; ++i)
+    shuffles.scatter[i] =
+        i < 4 * Channels ? (i % Channels) * 4 + i / Channels : -1;
+  return shuffles;
+}
+
+template <uint32_t Channels>
+inline constexpr ChannelShuffles<Channels> channel_shuffles_v =
+    channel_shuffles<Channels>();
+
+//!
+//! \brief Deinterleaves the leading pixels of a block of 8-bit RGB/RGBA pixels
+//! to float planes with byte shuffles (SSE4.1, AVX2, wasm simd128, NEON).
+//!
+//! \return The number of pixels deinterleaved, the caller handles the others.
+//!
+template <uint32_t Channels>
+int deinterleave_u8_simd([[maybe_unused]] const uint8_t *in,
+                         [[maybe_unused]] float *const *planes,
+                         [[maybe_unused]] const int count) {
+  int x = 0;
+#if defined(__SSE4_1__) || defined(__wasm_simd128__)
+  constexpr auto &shuffles = channel_shuffles_v<Channels>;
+#endif
+#if defined(__AVX2__)
+  // two overlapping 16 bytes loads of 4 pixels each
+  for (; (x + 4) * Channels + 16 <= count * Channels; x += 8) {
+    const __m128i a = _mm_loadu_si128((const __m128i *)(in + x * Channels));
+    const __m128i b =
+        _mm_loadu_si128((const __m128i *)(in + (x + 4) * Channels));
+    for (uint32_t c = 0; c < Channels; ++c) {
+      const __m128i mask = _mm_load_si128((const __m128i *)shuffles.gather[c]);
+      const __m128i samples = _mm_unpacklo_epi32(_mm_shuffle_epi8(a, mask),
+                                                 _mm_shuffle_epi8(b, mask));
+      _mm256_storeu_ps(planes[c] + x,
+                       _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(samples)));
+    }
+  }
+#endif
+#if defined(__SSE4_1__)
+  for (; x * Channels + 16 <= count * Channels; x += 4) {
+    const __m128i pixels =
+        _mm_loadu_si128((const __m128i *)(in + x * Channels));
+    for (uint32_t c = 0; c < Channels; ++c) {
+      const __m128i mask = _mm_load_si128((const __m128i *)shuffles.gather[c]);
+      _mm_storeu_ps(planes[c] + x, _mm_cvtepi32_ps(_mm_cvtepu8_epi32(
+                                       _mm_shuffle_epi8(pixels, mask))));
+    }
+  }
+#elif defined(__wasm_simd128__)
+  for (; x * Channels + 16 <= count * Channels; x += 4) {
+    const v128_t pixels = wasm_v128_load(in + x * Channels);
+    for (uint32_t c = 0; c < Channels; ++c) {
+      const v128_t samples =
+          wasm_i8x16_swizzle(pixels, wasm_v128_load(shuffles.gather[c]));
+      wasm_v128_store(planes[c] + x,
+                      wasm_f32x4_convert_i32x4(wasm_u32x4_extend_low_u16x8(
+                          wasm_u16x8_extend_low_u8x16(samples))));
+    }
+  }
+#elif defined(__aarch64__)
+  // structured loads deinterleave 16 pixels
+  for (; x + 16 <= count; x += 16) {
+    uint8x16_t samples[Channels];
+    if constexpr (Channels == 3) {
+      const uint8x16x3_t pixels = vld3q_u8(in + x * 3);
+      for (uint32_t c = 0; c < 3; ++c) samples[c] = pixels.val[c];
+    } else {
+      const uint8x16x4_t pixels = vld4q_u8(in + x * 4);
+      for (uint32_t c = 0; c < 4; ++c) samples[c] = pixels.val[c];
+    }
+    for (uint32_t c = 0; c < Channels; ++c) {
+      const uint16x8_t lo = vmovl_u8(vget_low_u8(samples[c]));
+      const uint16x8_t hi = vmovl_u8(vget_high_u8(samples[c]));
+      float *const plane = planes[c] + x;
+      vst1q_f32(plane, vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo))));
+      vst1q_f32(plane + 4, vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo))));
+      vst1q_f32(plane + 8, vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi))));
+      vst1q_f32(plane + 12, vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi))));
+    }
+  }
+#endif
+  return x;
+}
+
+//!
+//! \brief Interleaves the leading pixels of a block of float planes to 8-bit
+//! RGB/RGBA pixels, rounding and saturating as convert_sample of
+//! helpers.hpp (SSE4.1, AVX2, wasm simd128, NEON).
+//!
+//! \return The number of pixels interleaved, the caller handles the others.
+//!
+template <uint32_t Channels>
+int interleave_u8_simd([[maybe_unused]] const float *const *planes,
+                       [[maybe_unused]] uint8_t *out,
+                       [[maybe_unused]] const int count) {
+  int x = 0;
+#if defined(__SSE4_1__) || defined(__wasm_simd128__)
+  constexpr auto &shuffles = channel_shuffles_v<Channels>;
+#endif
+#if defined(__AVX2__)
+  {
+    const __m256 half = _mm256_set1_ps(0.5F), zero = _mm256_setzero_ps(),
+                 max = _mm256_set1_ps(255.0F);
+    const __m256i scatter = _mm256_broadcastsi128_si256(
+        _mm_load_si128((const __m128i *)shuffles.scatter));
+    auto samples = [&](const uint32_t c) {
+      if (c >= Channels) return _mm256_setzero_si256();
+      const __m256 v = _mm256_add_ps(_mm256_loadu_ps(planes[c] + x), half);
+      return _mm256_cvttps_epi32(
+          _mm256_min_ps(_mm256_max_ps(v, zero), max));
+    };
+    for (; x + 8 <= count; x += 8) {
+      // in-lane packs: pixels 0-3 in the low lane, 4-7 in the high one
+      const __m256i bytes = _mm256_shuffle_epi8(
+          _mm256_packus_epi16(_mm256_packus_epi32(samples(0), samples(1)),
+                              _mm256_packus_epi32(samples(2), samples(3))),
+          scatter);
+      uint8_t *const pixels = out + x * Channels;
+      if constexpr (Channels == 4) {
+        _mm256_storeu_si256((__m256i *)pixels, bytes);
+      } else {
+        const __m128i lo = _mm256_castsi256_si128(bytes);
+        const __m128i hi = _mm256_extracti128_si256(bytes, 1);
+        _mm_storel_epi64((__m128i *)pixels, lo);
+        const int32_t lo_tail = _mm_extract_epi32(lo, 2);
+        std::memcpy(pixels + 8, &lo_tail, 4);
+        _mm_storel_epi64((__m128i *)(pixels + 12), hi);
+        const int32_t hi_tail = _mm_extract_epi32(hi, 2);
+        std::memcpy(pixels + 20, &hi_tail, 4);
+      }
+    }
+  }
+#endif
+#if defined(__SSE4_1__)
+  const __m128 half = _mm_set1_ps(0.5F), zero = _mm_setzero_ps(),
+               max = _mm_set1_ps(255.0F);
+  const __m128i scatter = _mm_load_si128((const __m128i *)shuffles.scatter);
+  auto samples = [&](const uint32_t c) {
+    if (c >= Channels) return _mm_setzero_si128();
+    const __m128 v = _mm_add_ps(_mm_loadu_ps(planes[c] + x), half);
+    return _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(v, zero), max));
+  };
+  for (; x + 4 <= count; x += 4) {
+    const __m128i bytes = _mm_shuffle_epi8(
+        _mm_packus_epi16(_mm_packus_epi32(samples(0), samples(1)),
+                         _mm_packus_epi32(samples(2), samples(3))),
+        scatter);
+    uint8_t *const pixels = out + x * Channels;
+    if constexpr (Channels == 4) {
+      _mm_storeu_si128((__m128i *)pixels, bytes);
+    } else {
+      _mm_storel_epi64((__m128i *)pixels, bytes);
+      const int32_t tail = _mm_extract_epi32(bytes, 2);
+      std::memcpy(pixels + 8, &tail, 4);
+    }
+  }
+#elif defined(__wasm_simd128__)
+  const v128_t half = wasm_f32x4_splat(0.5F), zero = wasm_f32x4_splat(0.0F),
+               max = wasm_f32x4_splat(255.0F);
+  const v128_t scatter = wasm_v128_load(shuffles.scatter);
+  auto samples = [&](const uint32_t c) {
+    if (c >= Channels) return wasm_i32x4_splat(0);
+    const v128_t v = wasm_f32x4_add(wasm_v128_load(planes[c] + x), half);
+    return wasm_i32x4_trunc_sat_f32x4(
+        wasm_f32x4_min(wasm_f32x4_max(v, zero), max));
+  };
+  for (; x + 4 <= count; x += 4) {
+    const v128_t lo = wasm_u16x8_narrow_i32x4(samples(0), samples(1));
+    const v128_t hi = wasm_u16x8_narrow_i32x4(samples(2), samples(3));
+    const v128_t bytes =
+        wasm_i8x16_swizzle(wasm_u8x16_narrow_i16x8(lo, hi), scatter);
+    uint8_t *const pixels = out + x * Channels;
+    if constexpr (Channels == 4) {
+      wasm_v128_store(pixels, bytes);
+    } else {
+      wasm_v128_store64_lane(pixels, bytes, 0);
+      wasm_v128_store32_lane(pixels + 8, bytes, 2);
+    }
+  }
+#elif defined(__aarch64__)
+  // structured stores interleave 16 pixels
+  const float32x4_t half = vdupq_n_f32(0.5F), max = vdupq_n_f32(255.0F);
+  for (; x + 16 <= count; x += 16) {
+    uint8x16_t samples[Channels];
+    for (uint32_t c = 0; c < Channels; ++c) {
+      uint16x4_t words[4];
+      for (int i = 0; i < 4; ++i) {
+        const float32x4_t v = vaddq_f32(vld1q_f32(planes[c] + x + 4 * i), half);
+        // the conversion truncates and saturates negative values to 0
+        words[i] = vmovn_u32(vcvtq_u32_f32(vminq_f32(v, max)));
+      }
+      samples[c] =
+          vcombine_u8(vmovn_u16(vcombine_u16(words[0], words[1])),
+                      vmovn_u16(vcombine_u16(words[2], words[3])));
+    }
+    if constexpr (Channels == 3)
+      vst3q_u8(out + x * 3, uint8x16x3_t{{samples[0], samples[1], samples[2]}});
+    else
+      vst4q_u8(out + x * 4, uint8x16x4_t{{samples[0], samples[1], samples[2],
+                                          samples[3]}});
+  }
+#endif
+  return x;
+}
+
+//!
+//! \brief Converts the leading samples of a block of IEEE 754 binary16 samples
+//! to float (F16C, NEON).
+//!
+//! \return The number of samples converted, the caller handles the others.
+//!
+size_t half_to_float([[maybe_unused]] const uint16_t *in,
+                     [[maybe_unused]] float *out,
+                     [[maybe_unused]] const size_t count) {
+  size_t i = 0;
+#if defined(__F16C__)
+  for (; i + 8 <= count; i += 8)
+    _mm256_storeu_ps(out + i, _mm256_cvtph_ps(_mm_loadu_si128(
+                                  (const __m128i *)(in + i))));
+#elif defined(__aarch64__)
+  for (; i + 4 <= count; i += 4)
+    vst1q_f32(out + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(in + i))));
+#endif
+  return i;
+}
+
+//!
+//! \brief Converts the leading samples of a block of floats to IEEE 754
+//! binary16 rounding to nearest even (F16C, NEON).
+//!
+//! \return The number of samples converted, the caller handles the others.
+//!
+size_t float_to_half([[maybe_unused]] const float *in,
+                     [[maybe_unused]] uint16_t *out,
+                     [[maybe_unused]] const size_t count) {
+  size_t i = 0;
+#if defined(__F16C__)
+  for (; i + 8 <= count; i += 8)
+    _mm_storeu_si128(
+        (__m128i *)(out + i),
+        _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT));
+#elif defined(__aarch64__)
+  for (; i + 4 <= count; i += 4)
+    vst1_u16(out + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(in + i))));
+#endif
+  return i;
+}
+
+template <size_t PixelBytes>
+void transpose_tiles(const void *in, const size_t in_stride, void *out,
+                     const size_t out_stride, const int w, const int h,
+                     const bool stream) {
+  constexpr int tile = transpose_tile_size(PixelBytes);
+  if constexpr (tile > 0) {
+    const uint8_t *const src = (const uint8_t *)in;
+    uint8_t *const dst = (uint8_t *)out;
+    for (int x = 0; x + tile <= w; x += tile)
+      for (int y = 0; y + tile <= h; y += tile)
+        transpose_tile<PixelBytes>(
+            src + ((size_t)y * in_stride + x) * PixelBytes, in_stride,
+            dst + ((size_t)x * out_stride + y) * PixelBytes, out_stride,
+            stream);
+#if defined(__SSE2__)
+    if (stream) _mm_sfence();
+#endif
+  }
+}
+
+// The real parts of the kernel DFT are duplicated over the (real, imaginary)
+// pairs of the tile DFT, but the first pair holds the real DC and Nyquist bins
+void spectral_multiply(float *dft, const float *kernel_dft, const size_t size,
+                       const float scaler) {
+  if (size < 2) return;
+  const float nyquist = dft[1] * (kernel_dft[1] * scaler);
+  size_t i = 0;
+#if defined(__AVX512F__)
+  const __m512 scaler16 = _mm512_set1_ps(scaler);
+  for (; i + 16 <= size; i += 16) {
+    // the zero-masking form, the plain one reads an undefined register
+    const __m512 k = _mm512_mul_ps(
+        _mm512_maskz_permute_ps(0xFFFF, _mm512_loadu_ps(kernel_dft + i), 0xA0),
+        scaler16);
+    _mm512_storeu_ps(dft + i, _mm512_mul_ps(_mm512_loadu_ps(dft + i), k));
+  }
+#endif
+#if defined(__AVX__)
+  const __m256 scaler8 = _mm256_set1_ps(scaler);
+  for (; i + 8 <= size; i += 8) {
+    const __m256 k = _mm256_mul_ps(
+        _mm256_moveldup_ps(_mm256_loadu_ps(kernel_dft + i)), scaler8);
+    _mm256_storeu_ps(dft + i, _mm256_mul_ps(_mm256_loadu_ps(dft + i), k));
+  }
+#endif
+#if defined(__SSE2__)
+  const __m128 scaler4 = _mm_set1_ps(scaler);
+  for (; i + 4 <= size; i += 4) {
+    const __m128 k = _mm_loadu_ps(kernel_dft + i);
+    const __m128 real = _mm_shuffle_ps(k, k, _MM_SHUFFLE(2, 2, 0, 0));
+    _mm_storeu_ps(dft + i,
+                  _mm_mul_ps(_mm_loadu_ps(dft + i), _mm_mul_ps(real, scaler4)));
+  }
+#elif defined(__wasm_simd128__)
+  const v128_t scaler4 = wasm_f32x4_splat(scaler);
+  for (; i + 4 <= size; i += 4) {
+    const v128_t k = wasm_v128_load(kernel_dft + i);
+    const v128_t real = wasm_i32x4_shuffle(k, k, 0, 0, 2, 2);
+    wasm_v128_store(dft + i, wasm_f32x4_mul(wasm_v128_load(dft + i),
+                                            wasm_f32x4_mul(real, scaler4)));
+  }
+#elif defined(__aarch64__)
+  const float32x4_t scaler4 = vdupq_n_f32(scaler);
+  for (; i + 4 <= size; i += 4) {
+    const float32x4_t k = vld1q_f32(kernel_dft + i);
+    vst1q_f32(dft + i, vmulq_f32(vld1q_f32(dft + i),
+                                 vmulq_f32(vtrn1q_f32(k, k), scaler4)));
+  }
+#endif
+  for (; i + 1 < size; i += 2) {
+    const float k = kernel_dft[i] * scaler;
+    dft[i] *= k;
+    dft[i + 1] *= k;
+  }
+  dft[1] = nyquist;
+}
+
+// Vectors of the batched FFT, a row per lane
+#if defined(__AVX512F__)
+typedef __m512 FftVec;
+constexpr int fft_lanes = 16;
+FftVec vload(const float *p) { return _mm512_loadu_ps(p); }
+void vstore(float *p, const FftVec v) { _mm512_storeu_ps(p, v); }
+FftVec vset(const float x) { return _mm512_set1_ps(x); }
+FftVec vadd(const FftVec a, const FftVec b) { return _mm512_add_ps(a, b); }
+FftVec vsub(const FftVec a, const FftVec b) { return _mm512_sub_ps(a, b); }
+FftVec vmul(const FftVec a, const FftVec b) { return _mm512_mul_ps(a, b); }
+#elif defined(__AVX__)
+typedef __m256 FftVec;
+constexpr int fft_lanes = 8;
+FftVec vload(const float *p) { return _mm256_loadu_ps(p); }
+void vstore(float *p, const FftVec v) { _mm256_storeu_ps(p, v); }
+FftVec vset(const float x) { return _mm256_set1_ps(x); }
+FftVec vadd(const FftVec a, const FftVec b) { return _mm256_add_ps(a, b); }
+FftVec vsub(const FftVec a, const FftVec b) { return _mm256_sub_ps(a, b); }
+FftVec vmul(const FftVec a, const FftVec b) { return _mm256_mul_ps(a, b); }
+#elif defined(__SSE2__)
+typedef __m128 FftVec;
+constexpr int fft_lanes = 4;
+FftVec vload(const float *p) { return _mm_loadu_ps(p); }
+void vstore(float *p, const FftVec v) { _mm_storeu_ps(p, v); }
+FftVec vset(const float x) { return _mm_set1_ps(x); }
+FftVec vadd(const FftVec a, const FftVec b) { return _mm_add_ps(a, b); }
+FftVec vsub(const FftVec a, const FftVec b) { return _mm_sub_ps(a, b); }
+FftVec vmul(const FftVec a, const FftVec b) { return _mm_mul_ps(a, b); }
+#elif defined(__wasm_simd128__)
+typedef v128_t FftVec;
+constexpr int fft_lanes = 4;
+FftVec vload(const float *p) { return wasm_v128_load(p); }
+void vstore(float *p, const FftVec v) { wasm_v128_store(p, v); }
+FftVec vset(const float x) { return wasm_f32x4_splat(x); }
+FftVec vadd(const FftVec a, const FftVec b) { return wasm_f32x4_add(a, b); }
+FftVec vsub(const FftVec a, const FftVec b) { return wasm_f32x4_sub(a, b); }
+FftVec vmul(const FftVec a, const FftVec b) { return wasm_f32x4_mul(a, b); }
+#elif defined(__aarch64__)
+typedef float32x4_t FftVec;
+constexpr int fft_lanes = 4;
+FftVec vload(const float *p) { return vld1q_f32(p); }
+void vstore(float *p, const FftVec v) { vst1q_f32(p, v); }
+FftVec vset(const float x) { return vdupq_n_f32(x); }
+FftVec vadd(const FftVec a, const FftVec b) { return vaddq_f32(a, b); }
+FftVec vsub(const FftVec a, const FftVec b) { return vsubq_f32(a, b); }
+FftVec vmul(const FftVec a, const FftVec b) { return vmulq_f32(a, b); }
+#else
+typedef float FftVec;
+constexpr int fft_lanes = 1;
+FftVec vload(const float *p) { return *p; }
+void vstore(float *p, const FftVec v) { *p = v; }
+FftVec vset(const float x) { return x; }
+FftVec vadd(const FftVec a, const FftVec b) { return a + b; }
+FftVec vsub(const FftVec a, const FftVec b) { return a - b; }
+FftVec vmul(const FftVec a, const FftVec b) { return a * b; }
+#endif
+
+// A complex sample of every row, stored as the real parts of the rows followed
+// by the imaginary ones
+struct Complex {
+  FftVec re, im;
+};
+constexpr size_t complex_floats = 2 * fft_lanes;
+
+Complex cload(const float *p) { return {vload(p), vload(p + fft_lanes)}; }
+void cstore(float *p, const Complex c) {
+  vstore(p, c.re);
+  vstore(p + fft_lanes, c.im);
+}
+Complex cadd(const Complex a, const Complex b) {
+  return {vadd(a.re, b.re), vadd(a.im, b.im)};
+}
+Complex csub(const Complex a, const Complex b) {
+  return {vsub(a.re, b.re), vsub(a.im, b.im)};
+}
+Complex cscale(const Complex a, const FftVec s) {
+  return {vmul(a.re, s), vmul(a.im, s)};
+}
+Complex cmul(const Complex a, const float re, const float im) {
+  const FftVec r = vset(re), i = vset(im);
+  return {vsub(vmul(a.re, r), vmul(a.im, i)),
+          vadd(vmul(a.re, i), vmul(a.im, r))};
+}
+// a * -i for the forward transform, a * i for the backward one
+template <bool Forward>
+Complex rotate(const Complex a) {
+  if constexpr (Forward) return {a.im, vsub(vset(0.0F), a.re)};
+  return {vsub(vset(0.0F), a.im), a.re};
+}
+
+// DFT of Radix samples in place, the sign of the exponent given by Forward
+template <int Radix, bool Forward>
+void butterfly(Complex *a) {
+  if constexpr (Radix == 2) {
+    const Complex t = a[1];
+    a[1] = csub(a[0], t);
+    a[0] = cadd(a[0], t);
+  } else if constexpr (Radix == 3) {
+    const Complex sum = cadd(a[1], a[2]);
+    const Complex mid = csub(a[0], cscale(sum, vset(0.5F)));
+    const Complex rot =
+        rotate<Forward>(cscale(csub(a[1], a[2]), vset(0.86602540378F)));
+    a[0] = cadd(a[0], sum);
+    a[1] = cadd(mid, rot);
+    a[2] = csub(mid, rot);
+  } else if constexpr (Radix == 4) {
+    const Complex t0 = cadd(a[0], a[2]), t1 = csub(a[0], a[2]),
+                  t2 = cadd(a[1], a[3]),
+                  t3 = rotate<Forward>(csub(a[1], a[3]));
+    a[0] = cadd(t0, t2);
+    a[1] = cadd(t1, t3);
+    a[2] = csub(t0, t2);
+    a[3] = csub(t1, t3);
+  } else {
+    // cos and sin of 2 pi / 5 and 4 pi / 5
+    const FftVec c1 = vset(0.30901699437F), c2 = vset(-0.80901699437F),
+                 s1 = vset(0.95105651630F), s2 = vset(0.58778525229F);
+    const Complex sum14 = cadd(a[1], a[4]), sum23 = cadd(a[2], a[3]),
+                  dif14 = csub(a[1], a[4]), dif23 = csub(a[2], a[3]);
+    const Complex mid1 =
+        cadd(a[0], cadd(cscale(sum14, c1), cscale(sum23, c2)));
+    const Complex mid2 =
+        cadd(a[0], cadd(cscale(sum14, c2), cscale(sum23, c1)));
+    const Complex rot1 = rotate<Forward>(
+        cadd(cscale(dif14, s1), cscale(dif23, s2)));
+    const Complex rot2 = rotate<Forward>(
+        csub(cscale(dif14, s2), cscale(dif23, s1)));
+    a[0] = cadd(a[0], cadd(sum14, sum23));
+    a[1] = cadd(mid1, rot1);
+    a[4] = csub(mid1, rot1);
+    a[2] = cadd(mid2, rot2);
+    a[3] = csub(mid2, rot2);
+  }
+}
+
+// A Stockham pass: the DFTs of length L over the m * Radix interleaved
+// subsequences of in become the DFTs of length L * Radix over m subsequences,
+// sorted in out
+template <int Radix, bool Forward>
+void fft_pass(const float *in, float *out, const int L, const int m,
+              const float *twiddles) {
+  for (int j = 0; j < L; ++j) {
+    const float *w = twiddles + 2 * (Radix - 1) * j;
+    const float *src = in + (size_t)j * m * Radix * complex_floats;
+    for (int k = 0; k < m; ++k) {
+      Complex a[Radix];
+      for (int q = 0; q < Radix; ++q)
+        a[q] = cload(src + (size_t)(k + m * q) * complex_floats);
+      if (j)
+        for (int q = 1; q < Radix; ++q)
+          a[q] = cmul(a[q], w[2 * (q - 1)],
+                      Forward ? w[2 * (q - 1) + 1] : -w[2 * (q - 1) + 1]);
+      butterfly<Radix, Forward>(a);
+      for (int s = 0; s < Radix; ++s)
+        cstore(out + ((size_t)(j + L * s) * m + k) * complex_floats, a[s]);
+    }
+  }
+}
+
+// Complex samples [first, first + count) of a sequence, wrapping around
+struct LiveRange {
+  int first, count;
+
+  // Offset in the range of the samples congruent to x modulo period, the
+  // sample is in the range if below count
+  int offset(const int x, const int period) const {
+    return ((x - first) % period + period) % period;
+  }
+};
+
+// fft_pass skipping the inputs out of live_in, known to be zeros, and the
+// outputs out of live_out, left undefined. An input of the pass holds the
+// samples of the sequence congruent to its index modulo m * Radix, an output
+// the final samples congruent to its index modulo L * Radix. The offsets in
+// the ranges are stepped along the loops to spare the divisions.
+template <int Radix, bool Forward>
+void fft_pass_pruned(const float *in, float *out, const int L, const int m,
+                     const float *twiddles, const LiveRange live_in,
+                     const LiveRange live_out) {
+  const Complex zero = {vset(0.0F), vset(0.0F)};
+  const int in_period = m * Radix, out_period = L * Radix;
+  int out_offset[Radix], in_first_offset[Radix];
+  for (int s = 0; s < Radix; ++s) {
+    out_offset[s] = live_out.offset(L * s, out_period);
+    in_first_offset[s] = live_in.offset(m * s, in_period);
+  }
+
+  for (int j = 0; j < L; ++j) {
+    bool needed[Radix], any_needed = false;
+    for (int s = 0; s < Radix; ++s) {
+      any_needed |= needed[s] = out_offset[s] < live_out.count;
+      if (++out_offset[s] == out_period) out_offset[s] = 0;
+    }
+    if (!any_needed) continue;
+
+    const float *w = twiddles + 2 * (Radix - 1) * j;
+    const float *src = in + (size_t)j * m * Radix * complex_floats;
+    int in_offset[Radix];
+    for (int q = 0; q < Radix; ++q) in_offset[q] = in_first_offset[q];
+    for (int k = 0; k < m; ++k) {
+      Complex a[Radix];
+      int live = 0;
+      for (int q = 0; q < Radix; ++q) {
+        const bool is_live = in_offset[q] < live_in.count;
+        if (++in_offset[q] == in_period) in_offset[q] = 0;
+        if (!is_live) {
+          a[q] = zero;
+          continue;
+        }
+        a[q] = cload(src + (size_t)(k + m * q) * complex_floats);
+        live |= 1 << q;
+        if (j && q)
+          a[q] = cmul(a[q], w[2 * (q - 1)],
+                      Forward ? w[2 * (q - 1) + 1] : -w[2 * (q - 1) + 1]);
+      }
+      // the DFT of a[0] alone (or of zeros) is a[0] everywhere
+      if (live > 1)
+        butterfly<Radix, Forward>(a);
+      else
+        for (int s = 1; s < Radix; ++s) a[s] = a[0];
+      for (int s = 0; s < Radix; ++s)
+        if (needed[s])
+          cstore(out + ((size_t)(j + L * s) * m + k) * complex_floats, a[s]);
+    }
+  }
+}
+
+// Complex FFT of plan.size / 2 points from src, ending in last and
+// ping-ponging with other. The passes are pruned while the zeros out of
+// live_in or the outputs out of live_out span whole butterflies, i.e. the
+// first passes of a transform of few nonzero samples and the last ones of a
+// transform of few needed samples.
+template <bool Forward>
+void complex_fft(const BatchedFftPlan &plan, const float *src, float *last,
+                 float *other, const LiveRange live_in,
+                 const LiveRange live_out) {
+  const int points = plan.size / 2;
+  const float *twiddles = plan.twiddles;
+  int L = 1;
+  for (int s = 0; s < plan.stages; ++s) {
+    const int radix = plan.radix[s];
+    const int m = points / (L * radix);
+    float *dst = (plan.stages - 1 - s) % 2 ? other : last;
+    // worth it when the butterflies have a live input at most or when half of
+    // them are not needed
+    if (live_in.count <= m || live_out.count * 2 <= L) {
+      if (radix == 2)
+        fft_pass_pruned<2, Forward>(src, dst, L, m, twiddles, live_in,
+                                    live_out);
+      else if (radix == 3)
+        fft_pass_pruned<3, Forward>(src, dst, L, m, twiddles, live_in,
+                                    live_out);
+      else if (radix == 4)
+        fft_pass_pruned<4, Forward>(src, dst, L, m, twiddles, live_in,
+                                    live_out);
+      else
+        fft_pass_pruned<5, Forward>(src, dst, L, m, twiddles, live_in,
+                                    live_out);
+    } else if (radix == 2) {
+      fft_pass<2, Forward>(src, dst, L, m, twiddles);
+    } else if (radix == 3) {
+      fft_pass<3, Forward>(src, dst, L, m, twiddles);
+    } else if (radix == 4) {
+      fft_pass<4, Forward>(src, dst, L, m, twiddles);
+    } else {
+      fft_pass<5, Forward>(src, dst, L, m, twiddles);
+    }
+    twiddles += 2 * (radix - 1) * L;
+    L *= radix;
+    src = dst;
+  }
+}
+
+//!
+//! \brief Real FFTs of a row per lane through a complex FFT of half the
+//! length, the even samples being the real parts and the odd ones the
+//! imaginary parts. The spectra of the rows are split from the complex one as
+//! X[k] = E[k] + W^k O[k], E and O being the spectra of the even and the odd
+//! samples, and merged back before the backward transform. Only the complex
+//! samples holding the real ones in [first, last) are read by the forward
+//! transform or computed by the backward one.
+//!
+void batched_fft(const BatchedFftPlan &plan, const float *in, float *out,
+                 float *work, const bool forward, const int first,
+                 const int last) {
+  const int points = plan.size / 2;
+  const LiveRange all = {0, points},
+                  live = {first / 2, (last + 1) / 2 - first / 2};
+  const FftVec half = vset(0.5F);
+  if (forward) {
+    complex_fft<true>(plan, in, out, work, live, all);
+    // DC and Nyquist terms in the first pair, like pffft
+    const Complex z0 = cload(out);
+    cstore(out, {vadd(z0.re, z0.im), vsub(z0.re, z0.im)});
+    for (int k = 1; k <= points / 2; ++k) {
+      const Complex a = cload(out + k * complex_floats),
+                    b = cload(out + (points - k) * complex_floats);
+      const Complex even = cscale({vadd(a.re, b.re), vsub(a.im, b.im)}, half);
+      // (a - conj(b)) / 2i
+      const Complex odd = cscale({vadd(a.im, b.im), vsub(b.re, a.re)}, half);
+      const Complex t = cmul(odd, plan.split[2 * k], plan.split[2 * k + 1]);
+      const Complex xk = cadd(even, t), xnk = csub(even, t);
+      cstore(out + (points - k) * complex_floats,
+             {xnk.re, vsub(vset(0.0F), xnk.im)});
+      cstore(out + k * complex_floats, xk);
+    }
+    return;
+  }
+
+  // the passes end in out starting from the other buffer
+  float *merged = plan.stages % 2 ? work : out;
+  const Complex x0 = cload(in);
+  cstore(merged, {vadd(x0.re, x0.im), vsub(x0.re, x0.im)});
+  for (int k = 1; k <= points / 2; ++k) {
+    const Complex a = cload(in + k * complex_floats),
+                  b = cload(in + (points - k) * complex_floats);
+    const Complex p = {vadd(a.re, b.re), vsub(a.im, b.im)};
+    const Complex q = cmul({vsub(a.re, b.re), vadd(a.im, b.im)},
+                           plan.split[2 * k], -plan.split[2 * k + 1]);
+    cstore(merged + (points - k) * complex_floats,
+           {vadd(p.re, q.im), vsub(q.re, p.im)});
+    cstore(merged + k * complex_floats, {vsub(p.re, q.im), vadd(p.im, q.re)});
+  }
+  complex_fft<false>(plan, merged, out, work, all, live);
+}
+
+void batched_complex_fft(const BatchedFftPlan &plan, const float *in,
+                         float *out, float *work, const bool forward) {
+  const LiveRange all = {0, plan.size / 2};
+  if (forward)
+    complex_fft<true>(plan, in, out, work, all, all);
+  else
+    complex_fft<false>(plan, in, out, work, all, all);
+}
+
+void batched_spectral_multiply(float *dft, const float *kernel_dft,
+                               const size_t size, const float scaler) {
+  for (size_t i = 0; i < size; ++i)
+    vstore(dft + i * fft_lanes,
+           vmul(vload(dft + i * fft_lanes),
+                vset(kernel_dft[i == 1 ? 1 : i & ~(size_t)1] * scaler)));
+}
+
+}  // namespace
+
+extern const KernelTable table;
+const KernelTable table = {GAUSSIANBLUR_KERNELS_LEVEL,
+                           transpose_tile_size(4),
+                           transpose_tile_size(2),
+                           transpose_tiles<4>,
+                           transpose_tiles<2>,
+                           deinterleave_u8_simd<3>,
+                           deinterleave_u8_simd<4>,
+                           interleave_u8_simd<3>,
+                           interleave_u8_simd<4>,
+                           half_to_float,
+                           float_to_half,
+                           spectral_multiply,
+                           fft_lanes,
+                           batched_fft,
+                           batched_spectral_multiply,
+                           batched_complex_fft};
+
+}  // namespace GAUSSIANBLUR_KERNELS_NAMESPACE
+}  // namespace gaussianblur
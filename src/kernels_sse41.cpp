@@ -0,0 +1,5 @@
+// Kernels built with -msse4.1, selected on the CPUs supporting it: the byte
+// shuffles of the 8-bit (de)interleave need SSSE3 and SSE4.1
+#define GAUSSIANBLUR_KERNELS_NAMESPACE sse41
+#define GAUSSIANBLUR_KERNELS_LEVEL IsaLevel::SSE41
+#include "kernels_impl.hpp"
@@ -0,0 +1,294 @@
+#include <fcntl.h>
+#include <gaussianblur/gaussianblur.h>
+#include <gaussianblur/mapped_image.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <utility>
+
+namespace gaussianblur {
+
+namespace {
+
+size_t payload_size(const ImgGeom &image_geometry) {
+  return (size_t)image_geometry.rows * image_geometry.cols *
+         image_geometry.channels;
+}
+
+// Minimal tokenizer over the mapped header, skipping whitespaces and comments
+class HeaderReader {
+ public:
+  HeaderReader(const uint8_t *begin, const size_t size)
+      : cur(begin), end(begin + size) {}
+
+  std::string token() {
+    skip_blanks();
+    std::string tok;
+    while (cur < end && !std::isspace(*cur)) tok.push_back(*cur++);
+    return tok;
+  }
+
+  bool number(int &value) {
+    const std::string tok = token();
+    if (tok.empty() ||
+        !std::all_of(tok.begin(), tok.end(), [](unsigned char c) {
+          return std::isdigit(c);
+        }))
+      return false;
+    // a value past INT_MAX is a malformed header, not an exception
+    const auto [ptr, ec] =
+        std::from_chars(tok.data(), tok.data() + tok.size(), value);
+    return ec == std::errc() && ptr == tok.data() + tok.size();
+  }
+
+  // PGM/PPM: a single whitespace separates MAXVAL from the samples
+  bool skip_single_whitespace() {
+    if (cur >= end || !std::isspace(*cur)) return false;
+    ++cur;
+    return true;
+  }
+
+  // PAM: the samples start right after the line containing ENDHDR
+  bool skip_line() {
+    while (cur < end && *cur != '\n') ++cur;
+    if (cur >= end) return false;
+    ++cur;
+    return true;
+  }
+
+  const uint8_t *position() const { return cur; }
+
+ private:
+  void skip_blanks() {
+    while (cur < end) {
+      if (*cur == '#')
+        while (cur < end && *cur != '\n') ++cur;
+      else if (std::isspace(*cur))
+        ++cur;
+      else
+        break;
+    }
+  }
+
+  const uint8_t *cur;
+  const uint8_t *end;
+};
+
+std::optional<ImgGeom> parse_pnm_header(HeaderReader &reader) {
+  const std::string magic = reader.token();
+  ImgGeom geom = {0, 0, 0};
+  int maxval = 0;
+
+  if (magic == "P5" || magic == "P6") {
+    geom.channels = magic == "P5" ? 1 : 3;
+    if (!reader.number(geom.cols) || !reader.number(geom.rows) ||
+        !reader.number(maxval) || !reader.skip_single_whitespace())
+      return std::nullopt;
+  } else if (magic == "P7") {
+    for (std::string key = reader.token(); key != "ENDHDR";
+         key = reader.token()) {
+      if (key.empty()) return std::nullopt;
+      if (key == "WIDTH") {
+        if (!reader.number(geom.cols)) return std::nullopt;
+      } else if (key == "HEIGHT") {
+        if (!reader.number(geom.rows)) return std::nullopt;
+      } else if (key == "DEPTH") {
+        if (!reader.number(geom.channels)) return std::nullopt;
+      } else if (key == "MAXVAL") {
+        if (!reader.number(maxval)) return std::nullopt;
+      } else if (key == "TUPLTYPE") {
+        reader.token();
+      } else {
+        return std::nullopt;
+      }
+    }
+    if (!reader.skip_line()) return std::nullopt;
+  } else {
+    return std::nullopt;
+  }
+
+  if (maxval != 255 || geom.rows <= 0 || geom.cols <= 0 || geom.channels <= 0)
+    return std::nullopt;
+  return geom;
+}
+
+std::string pnm_header(const ImgGeom &image_geometry) {
+  const std::string size = std::to_string(image_geometry.cols) + " " +
+                           std::to_string(image_geometry.rows);
+  if (image_geometry.channels == 1) return "P5\n" + size + "\n255\n";
+  if (image_geometry.channels == 3) return "P6\n" + size + "\n255\n";
+
+  std::string header = "P7\nWIDTH " + std::to_string(image_geometry.cols) +
+                       "\nHEIGHT " + std::to_string(image_geometry.rows) +
+                       "\nDEPTH " + std::to_string(image_geometry.channels) +
+                       "\nMAXVAL 255\n";
+  if (image_geometry.channels == 2)
+    header += "TUPLTYPE GRAYSCALE_ALPHA\n";
+  else if (image_geometry.channels == 4)
+    header += "TUPLTYPE RGB_ALPHA\n";
+  return header + "ENDHDR\n";
+}
+
+}  // namespace
+
+std::optional<MappedImage> MappedImage::map(const std::string &path,
+                                            const bool writable,
+                                            const size_t new_size) {
+  int flags = writable ? O_RDWR : O_RDONLY;
+  if (new_size) flags |= O_CREAT | O_TRUNC;
+
+  const int fd = ::open(path.c_str(), flags, 0644);
+  if (fd < 0) {
+    std::cerr << "Failed to open " << path << ": " << std::strerror(errno)
+              << std::endl;
+    return std::nullopt;
+  }
+
+  size_t size = new_size;
+  if (new_size) {
+    if (ftruncate(fd, (off_t)new_size) != 0) {
+      std::cerr << "Failed to resize " << path << ": " << std::strerror(errno)
+                << std::endl;
+      close(fd);
+      return std::nullopt;
+    }
+  } else {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+      std::cerr << "Failed to stat " << path << std::endl;
+      close(fd);
+      return std::nullopt;
+    }
+    size = st.st_size;
+  }
+
+  void *addr =
+      mmap(nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+           writable ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+  // the mapping keeps its own reference to the file
+  close(fd);
+  if (addr == MAP_FAILED) {
+    std::cerr << "Failed to map " << path << ": " << std::strerror(errno)
+              << std::endl;
+    return std::nullopt;
+  }
+  madvise(addr, size, MADV_SEQUENTIAL);
+
+  MappedImage mapped;
+  mapped.mapping = addr;
+  mapped.mapping_size = size;
+  mapped.is_writable = writable;
+  return std::optional<MappedImage>{std::move(mapped)};
+}
+
+std::optional<MappedImage> MappedImage::open(const std::string &path,
+                                             const bool writable) {
+  std::optional<MappedImage> mapped = map(path, writable);
+  if (!mapped.has_value()) return std::nullopt;
+
+  const uint8_t *begin = (const uint8_t *)mapped->mapping;
+  HeaderReader reader(begin, mapped->mapping_size);
+  std::optional<ImgGeom> geom = parse_pnm_header(reader);
+  if (!geom.has_value()) {
+    std::cerr << "Unsupported PNM header: " << path << std::endl;
+    return std::nullopt;
+  }
+
+  const size_t header_size = reader.position() - begin;
+  if (mapped->mapping_size - header_size < payload_size(geom.value())) {
+    std::cerr << "Truncated PNM file: " << path << std::endl;
+    return std::nullopt;
+  }
+
+  mapped->geometry = geom.value();
+  mapped->first_pixel = (uint8_t *)mapped->mapping + header_size;
+  return mapped;
+}
+
+std::optional<MappedImage> MappedImage::open_raw(const std::string &path,
+                                                 const ImgGeom image_geometry,
+                                                 const bool writable) {
+  std::optional<MappedImage> mapped = map(path, writable);
+  if (!mapped.has_value()) return std::nullopt;
+
+  if (mapped->mapping_size < payload_size(image_geometry)) {
+    std::cerr << "Raw file smaller than the image geometry: " << path
+              << std::endl;
+    return std::nullopt;
+  }
+
+  mapped->geometry = image_geometry;
+  mapped->first_pixel = (uint8_t *)mapped->mapping;
+  return mapped;
+}
+
+std::optional<MappedImage> MappedImage::create(const std::string &path,
+                                               const ImgGeom image_geometry,
+                                               const MappedFormat format) {
+  if (image_geometry.rows <= 0 || image_geometry.cols <= 0 ||
+      image_geometry.channels <= 0) {
+    std::cerr << "Invalid image geometry" << std::endl;
+    return std::nullopt;
+  }
+
+  const std::string header =
+      format == MappedFormat::PNM ? pnm_header(image_geometry) : "";
+  std::optional<MappedImage> mapped =
+      map(path, true, header.size() + payload_size(image_geometry));
+  if (!mapped.has_value()) return std::nullopt;
+
+  std::memcpy(mapped->mapping, header.data(), header.size());
+  mapped->geometry = image_geometry;
+  mapped->first_pixel = (uint8_t *)mapped->mapping + header.size();
+  return mapped;
+}
+
+MappedImage::MappedImage(MappedImage &&other) noexcept {
+  *this = std::move(other);
+}
+
+MappedImage &MappedImage::operator=(MappedImage &&other) noexcept {
+  if (this != &other) {
+    unmap();
+    mapping = std::exchange(other.mapping, nullptr);
+    mapping_size = std::exchange(other.mapping_size, 0);
+    first_pixel = std::exchange(other.first_pixel, nullptr);
+    geometry = other.geometry;
+    is_writable = other.is_writable;
+  }
+  return *this;
+}
+
+MappedImage::~MappedImage() { unmap(); }
+
+void MappedImage::unmap() {
+  if (mapping) munmap(mapping, mapping_size);
+  mapping = nullptr;
+  mapping_size = 0;
+  first_pixel = nullptr;
+}
+
+bool gaussianblur(const MappedImage &src, MappedImage &dst, const float sigma,
+                  const bool apply_to_alpha) {
+  const ImgGeom &src_geom = src.geom();
+  const ImgGeom &dst_geom = dst.geom();
+  if (!dst.writable() || src_geom.rows != dst_geom.rows ||
+      src_geom.cols != dst_geom.cols ||
+      src_geom.channels != dst_geom.channels) {
+    std::cerr << "Destination mapping not writable or geometry mismatch"
+              << std::endl;
+    return false;
+  }
+
+  gaussianblur(src.pixels(), dst.mutable_pixels(), src_geom, sigma,
+               apply_to_alpha);
+  return true;
+}
+
+}  // namespace gaussianblur
@@ -1,12 +1,19 @@
 #include <array>
 #include <chrono>
 #include <cmath>
+#include <filesystem>
+#include <fstream>
 #include <gaussianblur/gaussianblur.h>
 #include <gaussianblur/helpers.hpp>
+#include <gaussianblur/mapped_image.h>
 #include <gtest/gtest.h>
 #include <iostream>
+#include <limits>
 #include <random>
 #include "test_helpers.hpp"
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
 
 // Test case for prepare_kernel_DFT
 TEST(GaussianBlurTest, PrepareKernelDFT) {
@@ -58,18 +65,12 @@ TEST(GaussianBlurTest, BasicTestRGB) {
   ASSERT_LT(blurred_variance, original_variance);
 }
 
-// Test case that
+// Test case for an image without channels
 TEST(GaussianBlurTest, InvalidChannelCount) {
-  // Create a 3x3 image with 2 channels
-  std::vector<uint8_t> image_data = {// Row 1
-                                     255, 0, 0, 255, 0, 0,
-                                     // Row 2
-                                     0, 0, 255, 255, 128, 128,
-                                     // Row 3
-                                     128, 0, 0, 128, 0, 0};
+  std::vector<uint8_t> image_data = {255, 0, 0, 255, 0, 0};
   std::vector<uint8_t> original_image_data = image_data;
 
-  ImgGeom image_geom = {3, 3, 2};  // 3x3 image with 2 channels
+  ImgGeom image_geom = {2, 3, 0};  // 2x3 image with 0 channels
   Image image = {image_data, image_geom};
 
   float sigma = 3.0F;
@@ -81,6 +82,53 @@ TEST(GaussianBlurTest, InvalidChannelCount) {
   ASSERT_EQ(image.data, original_image_data);
 }
 
+// Test case for grayscale, gray + alpha and multispectral images: each channel
+// is blurred on its own, like the same plane in a RGB image
+TEST(GaussianBlurTest, ArbitraryChannelCount) {
+  const int rows = 6, cols = 9, bands = 7;
+  std::vector<uint8_t> multispectral(rows * cols * bands);
+  std::mt19937 gen(7);
+  std::uniform_int_distribution<> dis(0, 255);
+  for (auto& sample : multispectral) sample = dis(gen);
+
+  // reference: every band blurred as the 1st channel of a RGB image
+  auto blur_plane = [&](const int band) {
+    Image rgb = {std::vector<uint8_t>(rows * cols * 3), {rows, cols, 3}};
+    for (int i = 0; i < rows * cols; ++i)
+      rgb.data[i * 3] = multispectral[i * bands + band];
+    gaussianblur::gaussianblur(rgb, 2.5F, false);
+    std::vector<uint8_t> plane(rows * cols);
+    for (int i = 0; i < rows * cols; ++i) plane[i] = rgb.data[i * 3];
+    return plane;
+  };
+
+  Image gray = {std::vector<uint8_t>(rows * cols), {rows, cols, 1}};
+  for (int i = 0; i < rows * cols; ++i)
+    gray.data[i] = multispectral[i * bands];
+  gaussianblur::gaussianblur(gray, 2.5F, false);
+  ASSERT_EQ(gray.data, blur_plane(0));
+
+  // gray + alpha, alpha left untouched
+  Image gray_alpha = {std::vector<uint8_t>(rows * cols * 2), {rows, cols, 2}};
+  for (int i = 0; i < rows * cols; ++i) {
+    gray_alpha.data[i * 2] = multispectral[i * bands];
+    gray_alpha.data[i * 2 + 1] = multispectral[i * bands + 1];
+  }
+  gaussianblur::gaussianblur(gray_alpha, 2.5F, false);
+  for (int i = 0; i < rows * cols; ++i) {
+    ASSERT_EQ(gray_alpha.data[i * 2], gray.data[i]);
+    ASSERT_EQ(gray_alpha.data[i * 2 + 1], multispectral[i * bands + 1]);
+  }
+
+  Image cube = {multispectral, {rows, cols, bands}};
+  gaussianblur::gaussianblur(cube, 2.5F, false);
+  for (int band = 0; band < bands; ++band) {
+    const std::vector<uint8_t> expected = blur_plane(band);
+    for (int i = 0; i < rows * cols; ++i)
+      ASSERT_EQ(cube.data[i * bands + band], expected[i]);
+  }
+}
+
 // Test case for Gaussian blur without applying to alpha channel
 TEST(GaussianBlurTest, BasicTestRGBAWithoutAlpha) {
   // Create a 3x3 RGBA image with sharp contrasts
@@ -168,7 +216,7 @@ TEST(GaussianBlurTest, BasicTestRGBAWithAlpha) {
   // Create a 3x3 RGBA image with sharp contrasts
   std::vector<uint8_t> image_data = {
       // Row 1
-      255, 0, 0, 128, 0, 255, 0, 128, 0, 0, 255, 128,
+      255, 0, 0, 255, 0, 255, 0, 255, 0, 0, 255, 255,
       // Row 2
       0, 0, 0, 128, 255, 255, 255, 128, 128, 128, 128, 128,
       // Row 3
@@ -194,16 +242,654 @@ TEST(GaussianBlurTest, BasicTestRGBAWithAlpha) {
   // Check that the variance is lower in the blurred image
   ASSERT_LT(blurred_variance, original_variance);
 
-  // Check that the alpha channel has been altered
+  // Check that the alpha channel has been altered, a constant alpha would be
+  // left as is
   bool alpha_altered = false;
   for (size_t i = 3; i < image.data.size(); i += 4)
-    if (image.data[i] != 128) {
+    if (image.data[i] != image_data[i]) {
       alpha_altered = true;
       break;
     }
   ASSERT_TRUE(alpha_altered);
 }
 
+// Test case for blurring a memory mapped PPM into a mapped PAM output
+TEST(GaussianBlurTest, MappedImage) {
+  const std::vector<uint8_t> image_data = {// Row 1
+                                           255, 0, 0, 0, 255, 0, 0, 0, 255,
+                                           // Row 2
+                                           0, 0, 0, 255, 255, 255, 128, 128,
+                                           128,
+                                           // Row 3
+                                           128, 0, 0, 0, 128, 0, 0, 0, 128};
+  const auto dir = std::filesystem::temp_directory_path();
+  const std::string src_path = (dir / "gaussianblur_mapped_src.ppm").string();
+  const std::string dst_path = (dir / "gaussianblur_mapped_dst.ppm").string();
+  {
+    std::ofstream file(src_path, std::ios::binary);
+    file << "P6\n# comment\n3 3\n255\n";
+    file.write((const char*)image_data.data(), image_data.size());
+  }
+
+  Image image = {image_data, ImgGeom{3, 3, 3}};
+  gaussianblur::gaussianblur(image, 3.0F, false);
+
+  {
+    std::optional<gaussianblur::MappedImage> src =
+        gaussianblur::MappedImage::open(src_path);
+    ASSERT_TRUE(src.has_value());
+    ASSERT_FALSE(src->writable());
+    ASSERT_EQ(src->geom().rows, 3);
+    ASSERT_EQ(src->geom().cols, 3);
+    ASSERT_EQ(src->geom().channels, 3);
+
+    // a read-only mapping can't be the destination
+    std::optional<gaussianblur::MappedImage> read_only =
+        gaussianblur::MappedImage::open(src_path);
+    ASSERT_FALSE(gaussianblur::gaussianblur(src.value(), read_only.value(),
+                                            3.0F, false));
+
+    std::optional<gaussianblur::MappedImage> dst =
+        gaussianblur::MappedImage::create(dst_path, src->geom(),
+                                          gaussianblur::MappedFormat::PNM);
+    ASSERT_TRUE(dst.has_value());
+    ASSERT_TRUE(gaussianblur::gaussianblur(src.value(), dst.value(), 3.0F,
+                                           false));
+  }
+
+  // the output is a valid PPM holding the same result of the in-memory blur
+  std::optional<gaussianblur::MappedImage> out =
+      gaussianblur::MappedImage::open(dst_path);
+  ASSERT_TRUE(out.has_value());
+  ASSERT_TRUE(std::equal(image.data.begin(), image.data.end(), out->pixels()));
+
+  // a malformed header is rejected with std::nullopt, a size past INT_MAX
+  // included
+  for (const char *header : {"P6 99999999999 1 255\n", "P6 3 -3 255\n",
+                             "P7\nWIDTH 3\nHEIGHT 3\nDEPTH 3\nENDHDR\n"}) {
+    {
+      std::ofstream file(src_path, std::ios::binary | std::ios::trunc);
+      file << header;
+      file.write((const char*)image_data.data(), image_data.size());
+    }
+    ASSERT_FALSE(gaussianblur::MappedImage::open(src_path).has_value())
+        << header;
+  }
+
+  std::filesystem::remove(src_path);
+  std::filesystem::remove(dst_path);
+}
+
+// Test case for strided views: a BGRX sub-rectangle of a padded surface is
+// blurred into a planar buffer, without touching the padding
+TEST(GaussianBlurTest, StridedImageView) {
+  const int rows = 5, cols = 7;
+  std::vector<uint8_t> packed(rows * cols * 3);
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<> dis(0, 255);
+  for (auto& sample : packed) sample = dis(gen);
+
+  // surface of (rows + 2) x (cols + 3) BGRX pixels with the image at (1, 2)
+  const int surface_cols = cols + 3;
+  std::vector<uint8_t> surface((rows + 2) * surface_cols * 4, 7);
+  const ImageView surface_view = {surface.data(),
+                                  ImgGeom{rows + 2, surface_cols, 3},
+                                  surface_cols * 4, 4, 1};
+  const ImageView src = surface_view.subview(1, 2, rows, cols);
+  for (int y = 0; y < rows; ++y)
+    for (int x = 0; x < cols; ++x)
+      for (int c = 0; c < 3; ++c)
+        src.data[y * src.row_stride + x * src.pixel_stride + c] =
+            packed[(y * cols + x) * 3 + c];
+  const std::vector<uint8_t> original_surface = surface;
+  ASSERT_FALSE(src.is_contiguous());
+
+  // planar destination, one plane per channel
+  std::vector<uint8_t> planar(rows * cols * 3);
+  const ImageView dst = {planar.data(), ImgGeom{rows, cols, 3}, cols, 1,
+                         rows * cols};
+
+  Image image = {packed, ImgGeom{rows, cols, 3}};
+  gaussianblur::gaussianblur(image, 2.0F, false);
+  gaussianblur::gaussianblur(src, dst, 2.0F, false);
+
+  for (int y = 0; y < rows; ++y)
+    for (int x = 0; x < cols; ++x)
+      for (int c = 0; c < 3; ++c)
+        ASSERT_EQ(planar[c * rows * cols + y * cols + x],
+                  image.data[(y * cols + x) * 3 + c]);
+  // the source view is read only
+  ASSERT_EQ(surface, original_surface);
+
+  // in place on the sub-rectangle, the padding bytes are left untouched
+  gaussianblur::gaussianblur(src, 2.0F, false);
+  for (int y = 0; y < rows + 2; ++y)
+    for (int x = 0; x < surface_cols; ++x)
+      for (int c = 0; c < 4; ++c) {
+        const size_t i = (y * surface_cols + x) * 4 + c;
+        const bool inside = y >= 1 && y < rows + 1 && x >= 2 &&
+                            x < cols + 2 && c < 3;
+        if (inside)
+          ASSERT_EQ(surface[i],
+                    image.data[((y - 1) * cols + (x - 2)) * 3 + c]);
+        else
+          ASSERT_EQ(surface[i], 7);
+      }
+}
+
+// Test case for uint16 and float images: same blur of the 8-bit image, with
+// the full precision of the sample type
+TEST(GaussianBlurTest, HighBitDepthImages) {
+  const int rows = 8, cols = 11;
+  std::vector<uint8_t> image_data(rows * cols * 3);
+  std::mt19937 gen(3);
+  std::uniform_int_distribution<> dis(0, 255);
+  for (auto& sample : image_data) sample = dis(gen);
+
+  Image image = {image_data, ImgGeom{rows, cols, 3}};
+  Image16 image16 = {std::vector<uint16_t>(image_data.size()), image.geom};
+  ImageF32 imagef = {std::vector<float>(image_data.size()), image.geom};
+  for (size_t i = 0; i < image_data.size(); ++i) {
+    image16.data[i] = image_data[i] * 257;
+    imagef.data[i] = image_data[i] / 255.0F;
+  }
+
+  gaussianblur::gaussianblur(image, 2.0F, false);
+  gaussianblur::gaussianblur(image16, 2.0F, false);
+  gaussianblur::gaussianblur(imagef, 2.0F, false);
+
+  bool fractional_samples = false;
+  for (size_t i = 0; i < image_data.size(); ++i) {
+    ASSERT_NEAR(image16.data[i] / 257.0F, image.data[i], 0.5F);
+    ASSERT_NEAR(imagef.data[i] * 255.0F, image16.data[i] / 257.0F, 0.01F);
+    fractional_samples |= image16.data[i] % 257 != 0;
+  }
+  // the 16-bit result is not quantized to 8-bit
+  ASSERT_TRUE(fractional_samples);
+}
+
+// Test case for premultiplied alpha: the color of transparent pixels must not
+// bleed into the visible ones
+TEST(GaussianBlurTest, PremultipliedAlpha) {
+  const int rows = 8, cols = 8;
+  // left half opaque blue, right half transparent red
+  std::vector<uint8_t> image_data(rows * cols * 4);
+  for (int i = 0; i < rows * cols; ++i) {
+    const bool opaque = i % cols < cols / 2;
+    image_data[i * 4 + 0] = opaque ? 0 : 255;
+    image_data[i * 4 + 1] = 0;
+    image_data[i * 4 + 2] = opaque ? 255 : 0;
+    image_data[i * 4 + 3] = opaque ? 255 : 0;
+  }
+
+  Image straight = {image_data, ImgGeom{rows, cols, 4}};
+  gaussianblur::gaussianblur(straight, 2.0F, true);
+  Image premultiplied = {image_data, ImgGeom{rows, cols, 4}};
+  gaussianblur::BlurOptions options;
+  options.premultiply_alpha = true;
+  gaussianblur::gaussianblur(premultiplied, 2.0F, options);
+
+  bool straight_fringes = false;
+  for (int i = 0; i < rows * cols; ++i) {
+    // same coverage in both modes
+    ASSERT_EQ(premultiplied.data[i * 4 + 3], straight.data[i * 4 + 3]);
+    if (straight.data[i * 4 + 3] > 0 && straight.data[i * 4 + 0] > 8)
+      straight_fringes = true;
+    // visible pixels stay blue
+    if (premultiplied.data[i * 4 + 3] > 0) {
+      ASSERT_LE(premultiplied.data[i * 4 + 0], 1);
+      ASSERT_GE(premultiplied.data[i * 4 + 2], 254);
+    }
+  }
+  ASSERT_TRUE(straight_fringes);
+
+  // an opaque image is blurred as with straight alpha
+  for (int i = 0; i < rows * cols; ++i) image_data[i * 4 + 3] = 255;
+  Image opaque_straight = {image_data, ImgGeom{rows, cols, 4}};
+  Image opaque_premultiplied = {image_data, ImgGeom{rows, cols, 4}};
+  gaussianblur::gaussianblur(opaque_straight, 2.0F, true);
+  gaussianblur::gaussianblur(opaque_premultiplied, 2.0F, options);
+  ASSERT_EQ(opaque_premultiplied.data, opaque_straight.data);
+}
+
+TEST(GaussianBlurTest, LinearLight) {
+  const int rows = 8, cols = 8;
+  // left half white, right half black
+  std::vector<uint8_t> image_data(rows * cols * 3);
+  for (int i = 0; i < rows * cols; ++i)
+    for (int c = 0; c < 3; ++c)
+      image_data[i * 3 + c] = i % cols < cols / 2 ? 255 : 0;
+
+  Image gamma = {image_data, ImgGeom{rows, cols, 3}};
+  gaussianblur::gaussianblur(gamma, 2.0F, false);
+  Image linear = {image_data, ImgGeom{rows, cols, 3}};
+  gaussianblur::BlurOptions options;
+  options.linear_light = true;
+  gaussianblur::gaussianblur(linear, 2.0F, options);
+
+  // the transition is brighter in linear light, the dark band is not muddy
+  const int edge = (rows / 2 * cols + cols / 2) * 3;
+  ASSERT_GT(linear.data[edge], gamma.data[edge] + 16);
+  for (size_t i = 0; i < linear.data.size(); ++i)
+    ASSERT_GE(linear.data[i] + 1, gamma.data[i]);
+}
+
+TEST(GaussianBlurTest, ChannelMask) {
+  const int rows = 12, cols = 10;
+  std::vector<uint8_t> image_data(rows * cols * 4);
+  for (size_t i = 0; i < image_data.size(); ++i)
+    image_data[i] = (i * 37 + i / 7) % 256;
+
+  Image full = {image_data, ImgGeom{rows, cols, 4}};
+  gaussianblur::gaussianblur(full, 3.0F, true);
+
+  // alpha only, into a distinct destination: colors are copied
+  std::vector<uint8_t> shadow(image_data.size());
+  gaussianblur::BlurOptions options;
+  options.channel_mask = gaussianblur::alpha_only_mask(4);
+  gaussianblur::gaussianblur(make_view(image_data.data(), full.geom),
+                             make_view(shadow.data(), full.geom), 3.0F,
+                             options);
+  for (size_t i = 0; i < image_data.size(); ++i)
+    ASSERT_EQ(shadow[i], i % 4 == 3 ? full.data[i] : image_data[i]);
+
+  // red and blue in place: green and alpha are untouched
+  Image masked = {image_data, ImgGeom{rows, cols, 4}};
+  options.channel_mask = 1U << 0 | 1U << 2;
+  gaussianblur::gaussianblur(masked, 3.0F, options);
+  for (size_t i = 0; i < image_data.size(); ++i)
+    ASSERT_EQ(masked.data[i], i % 2 == 0 ? full.data[i] : image_data[i]);
+}
+
+TEST(GaussianBlurTest, ConstantAndDuplicateChannels) {
+  const int rows = 9, cols = 11;
+  // gray stored as RGBA with an opaque alpha
+  std::vector<uint8_t> gray_data(rows * cols);
+  std::vector<uint8_t> rgba_data(rows * cols * 4);
+  for (int i = 0; i < rows * cols; ++i) {
+    gray_data[i] = (i * 53) % 256;
+    for (int c = 0; c < 3; ++c) rgba_data[i * 4 + c] = gray_data[i];
+    rgba_data[i * 4 + 3] = 255;
+  }
+
+  Image gray = {gray_data, ImgGeom{rows, cols, 1}};
+  gaussianblur::gaussianblur(gray, 2.0F, false);
+  Image rgba = {rgba_data, ImgGeom{rows, cols, 4}};
+  gaussianblur::gaussianblur(rgba, 2.0F, true);
+
+  for (int i = 0; i < rows * cols; ++i) {
+    for (int c = 0; c < 3; ++c) ASSERT_EQ(rgba.data[i * 4 + c], gray.data[i]);
+    ASSERT_EQ(rgba.data[i * 4 + 3], 255);
+  }
+}
+
+// Test case for is_constant_plane
+TEST(HelpersTest, IsConstantPlane) {
+  std::vector<float> plane(37, 3.0F);
+  ASSERT_TRUE(is_constant_plane(plane.data(), plane.size()));
+  plane[20] = 2.0F;
+  ASSERT_FALSE(is_constant_plane(plane.data(), plane.size()));
+  plane[20] = 3.0F;
+  plane[36] = 2.0F;
+  ASSERT_FALSE(is_constant_plane(plane.data(), plane.size()));
+}
+
+TEST(GaussianBlurTest, HalfPrecisionPlanes) {
+  const int rows = 40, cols = 33;
+  std::vector<uint8_t> image_data(rows * cols * 3);
+  for (size_t i = 0; i < image_data.size(); ++i)
+    image_data[i] = (i * 41 + i / 13) % 256;
+
+  Image reference = {image_data, ImgGeom{rows, cols, 3}};
+  gaussianblur::gaussianblur(reference, 2.0F, false);
+
+  for (const auto &[storage, tolerance] :
+       {std::pair{gaussianblur::PlaneStorage::Float16, 1},
+        std::pair{gaussianblur::PlaneStorage::BFloat16, 2}}) {
+    Image image = {image_data, ImgGeom{rows, cols, 3}};
+    gaussianblur::BlurOptions options;
+    options.intermediate = storage;
+    gaussianblur::gaussianblur(image, 2.0F, options);
+    for (size_t i = 0; i < image.data.size(); ++i)
+      ASSERT_NEAR(image.data[i], reference.data[i], tolerance);
+  }
+}
+
+// Test case for the 16-bit float conversions
+TEST(HelpersTest, HalfConversions) {
+  for (const float value : {0.0F, -0.0F, 1.0F, -2.5F, 255.0F, 65504.0F,
+                            6.1035156e-05F, 5.9604645e-08F})
+    ASSERT_EQ((float)Float16(value), value);
+  ASSERT_EQ((float)Float16(1.0F + 1.0F / 4096), 1.0F);
+  ASSERT_TRUE(std::isinf((float)Float16(1e6F)));
+  ASSERT_EQ((float)BFloat16(255.0F), 255.0F);
+  ASSERT_EQ((float)BFloat16(257.0F), 256.0F);
+
+  std::vector<float> values(19), round_trip(19);
+  std::vector<Float16> halves(19);
+  for (size_t i = 0; i < values.size(); ++i) values[i] = i * 13.5F;
+  convert_n(values.data(), values.size(), halves.data());
+  convert_n(halves.data(), halves.size(), round_trip.data());
+  ASSERT_EQ(round_trip, values);
+}
+
+TEST(GaussianBlurTest, LeanMemory) {
+  const int rows = 256, cols = 256;
+  std::vector<uint8_t> image_data(rows * cols * 4);
+  for (size_t i = 0; i < image_data.size(); ++i)
+    image_data[i] = (i * 29 + i / 11) % 256;
+
+  gaussianblur::BlurStats default_stats, lean_stats;
+  Image reference = {image_data, ImgGeom{rows, cols, 4}};
+  gaussianblur::BlurOptions options;
+  options.apply_to_alpha = true;
+  options.stats = &default_stats;
+  gaussianblur::gaussianblur(reference, 2.0F, options);
+
+  Image lean = {image_data, ImgGeom{rows, cols, 4}};
+  options.lean_memory = true;
+  options.stats = &lean_stats;
+  gaussianblur::gaussianblur(lean, 2.0F, options);
+  ASSERT_EQ(lean.data, reference.data);
+
+  // four planes plus at least a scratch plane against a plane and a scratch
+  // plane, both plus the FFT buffers of each thread
+  const size_t plane_bytes = rows * cols * sizeof(float);
+  ASSERT_GE(default_stats.peak_bytes, 5 * plane_bytes);
+  ASSERT_GE(lean_stats.peak_bytes, 2 * plane_bytes);
+  ASSERT_LT(lean_stats.peak_bytes + 2 * plane_bytes, default_stats.peak_bytes);
+}
+
+// Test case for the recycling of the aligned buffers
+TEST(HelpersTest, BufferPool) {
+  ASSERT_EQ(BufferPool::size_class(100), 256);
+  ASSERT_EQ(BufferPool::size_class(1000), 1024);
+  ASSERT_EQ(BufferPool::size_class(1025), 1280);
+
+  BufferPool &pool = buffer_pool();
+  pool.set_capacity(64 * 1024 * 1024);
+  const BufferPoolStats before = pool.stats();
+
+  std::vector<uint8_t> image_data(128 * 96 * 3, 7);
+  image_data[1000] = 200;
+  for (int i = 0; i < 2; ++i) {
+    Image image = {image_data, ImgGeom{128, 96, 3}};
+    gaussianblur::gaussianblur(image, 2.0F, false);
+  }
+  // the second blur reuses the planes freed by the first one
+  const BufferPoolStats after = pool.stats();
+  ASSERT_GT(after.hits, before.hits);
+  ASSERT_GT(after.bytes_held, 0);
+  ASSERT_LE(after.bytes_held, 64 * 1024 * 1024);
+
+  pool.trim(BufferPool::size_class(1));
+  ASSERT_LE(pool.stats().bytes_held, BufferPool::size_class(1));
+  pool.set_capacity(0);
+  ASSERT_EQ(pool.stats().bytes_held, 0);
+  ASSERT_EQ(pool.stats().blocks_held, 0);
+}
+
+// Test case for the buffers backed by 2 MB pages
+TEST(HelpersTest, HugePageBlocks) {
+  huge_page_threshold = HUGE_PAGE_SIZE;
+  {
+    AlignedVector<float> plane(3 * HUGE_PAGE_SIZE / sizeof(float) + 5);
+    ASSERT_EQ((size_t)plane.data() % MALLOC_V4SF_ALIGNMENT, 0);
+    for (size_t i = 0; i < plane.size(); ++i) plane[i] = (float)i;
+    ASSERT_EQ(plane.back(), (float)(plane.size() - 1));
+    AlignedVector<float> small(16, 1.0F);
+  }
+  std::vector<uint8_t> image_data(1100 * 700, 9);
+  image_data[5000] = 90;
+  Image image = {image_data, ImgGeom{1100, 700, 1}};
+  huge_page_threshold = 0;
+  Image reference = image;
+  gaussianblur::gaussianblur(reference, 2.0F, false);
+  huge_page_threshold = HUGE_PAGE_SIZE;
+  gaussianblur::gaussianblur(image, 2.0F, false);
+  huge_page_threshold = 0;
+  ASSERT_EQ(image.data, reference.data);
+}
+
+// Allocator counting its live blocks and bytes
+class CountingAllocator : public BufferAllocator {
+ public:
+  void *allocate(size_t bytes, size_t alignment) override {
+    ++blocks;
+    live_bytes += bytes;
+    return std::aligned_alloc(alignment, (bytes + alignment - 1) /
+                                             alignment * alignment);
+  }
+  void deallocate(void *block, size_t bytes) override {
+    --blocks;
+    live_bytes -= bytes;
+    std::free(block);
+  }
+
+  std::atomic<int> blocks{0};
+  std::atomic<size_t> live_bytes{0};
+};
+
+// Allocator of a fixed budget of bytes, returning nullptr past it
+class ArenaAllocator : public CountingAllocator {
+ public:
+  explicit ArenaAllocator(const size_t budget) : budget(budget) {}
+  void *allocate(size_t bytes, size_t alignment) override {
+    if (live_bytes + bytes > budget) return nullptr;
+    return CountingAllocator::allocate(bytes, alignment);
+  }
+
+  const size_t budget;
+};
+
+TEST(GaussianBlurTest, CustomAllocator) {
+  std::vector<uint8_t> image_data(50 * 40 * 4);
+  for (size_t i = 0; i < image_data.size(); ++i)
+    image_data[i] = (i * 17 + i / 5) % 256;
+
+  Image reference = {image_data, ImgGeom{50, 40, 4}};
+  gaussianblur::gaussianblur(reference, 2.0F, true);
+
+  CountingAllocator allocator;
+  const BufferPoolStats pool_before = buffer_pool().stats();
+  Image image = {image_data, ImgGeom{50, 40, 4}};
+  gaussianblur::BlurOptions options;
+  options.apply_to_alpha = true;
+  options.allocator = &allocator;
+  gaussianblur::BlurStats stats;
+  options.stats = &stats;
+  gaussianblur::gaussianblur(image, 2.0F, options);
+
+  ASSERT_EQ(image.data, reference.data);
+  // every buffer came from the allocator and went back to it
+  ASSERT_EQ(allocator.blocks, 0);
+  ASSERT_EQ(allocator.live_bytes, 0);
+  ASSERT_GE(stats.peak_bytes, 4 * 50 * 40 * sizeof(float));
+  ASSERT_EQ(buffer_pool().stats().misses, pool_before.misses);
+
+  // two long rows, fewer than the lanes of the batched FFT, go through the
+  // four-step FFT, whose setup and buffers come from the allocator as well
+  const ImgGeom lines_geom = {2, 1 << 15, 1};
+  if (gaussianblur::default_fft_backend().batch() > 2) {
+    ASSERT_TRUE(gaussianblur::prepare_kernel_DFT(lines_geom, 2.0F)
+                    .cols_setup->is_parallel());
+  }
+  ImageF32 lines = {std::vector<float>((size_t)2 << 15), lines_geom};
+  for (size_t i = 0; i < lines.data.size(); ++i)
+    lines.data[i] = (i * 7 % 100) / 100.0F;
+  ImageF32 lines_reference = lines;
+  gaussianblur::gaussianblur(lines_reference, 2.0F,
+                             gaussianblur::BlurOptions{});
+  gaussianblur::BlurOptions lines_options;
+  lines_options.allocator = &allocator;
+  gaussianblur::gaussianblur(lines, 2.0F, lines_options);
+  ASSERT_EQ(lines.data, lines_reference.data);
+  ASSERT_EQ(allocator.blocks, 0);
+  ASSERT_EQ(allocator.live_bytes, 0);
+
+  // an exhausted arena fails the blur with std::bad_alloc, the image
+  // untouched if nothing could be allocated, and every block handed out
+  // before the failure is given back
+  for (const size_t budget : {(size_t)0, (size_t)12 * 1024}) {
+    ArenaAllocator arena(budget);
+    Image failed = {image_data, ImgGeom{50, 40, 4}};
+    gaussianblur::BlurOptions arena_options;
+    arena_options.allocator = &arena;
+    ASSERT_THROW(gaussianblur::gaussianblur(failed, 2.0F, arena_options),
+                 std::bad_alloc)
+        << budget;
+    if (budget == 0) {
+      ASSERT_EQ(failed.data, image_data);
+    }
+    ASSERT_EQ(arena.blocks, 0) << budget;
+  }
+}
+
+// Allocator recording the requested size, handing out a small block since
+// the sizes of the test don't fit in memory
+class RecordingAllocator : public BufferAllocator {
+ public:
+  void *allocate(size_t bytes, size_t alignment) override {
+    requested = bytes;
+    return std::aligned_alloc(alignment, 1024);
+  }
+  void deallocate(void *block, size_t) override { std::free(block); }
+
+  size_t requested = 0;
+};
+
+// Test case for the indexing of images beyond 2^31 samples
+TEST(HelpersTest, HugeGeometries) {
+  // a 50k x 50k RGBA mosaic
+  const size_t plane_size = (size_t)50000 * 50000;
+  ASSERT_GT(plane_size, (size_t)std::numeric_limits<int32_t>::max());
+  const size_t block =
+      interleave_block_size(plane_size, 4 * (sizeof(uint8_t) + sizeof(float)));
+  const BlockPartition blocks = partition_blocks(plane_size, block);
+  ASSERT_EQ(blocks.count, (plane_size + block - 1) / block);
+  ASSERT_EQ((blocks.count - 1) * block + blocks.last_block_size, plane_size);
+  ASSERT_EQ(partition_blocks(4 * block, block).last_block_size, block);
+
+  // the element count is not truncated on the way to the allocation
+  RecordingAllocator allocator;
+  const AllocationContext previous = allocation_context;
+  allocation_context.allocator = &allocator;
+  PFAlloc<float> alloc;
+  const size_t samples = plane_size * 4;
+  float *p = alloc.allocate(samples);
+  ASSERT_NE(p, nullptr);
+  ASSERT_GE(allocator.requested, samples * sizeof(float));
+  alloc.deallocate(p, samples);
+  allocation_context = previous;
+
+  // rows of a 2^31 samples plane are addressed past the 32-bit range
+  const ImgGeom geom = {50000, 50000, 4};
+  ImageView view = make_view((uint8_t *)nullptr, geom);
+  const ImageView last_row = view.subview(geom.rows - 1, 0, 1, geom.cols);
+  ASSERT_EQ((size_t)last_row.data, (size_t)(geom.rows - 1) * geom.cols * 4);
+}
+
+#if defined(__linux__)
+// Test case for the samples of a 50k x 50k RGBA mosaic past 2^31 bytes, in a
+// sparse mapping of which only the pages touched are backed: a tile at its
+// end is blurred through the strided (de)interleave, and rows of floats 2^31
+// samples apart are transposed by the kernels of every level
+TEST(HelpersTest, HugeMosaicTiles) {
+  const ImgGeom geom = {50000, 50000, 4};
+  const size_t bytes = (size_t)geom.rows * geom.cols * geom.channels;
+  void *const mapping =
+      mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (mapping == MAP_FAILED) GTEST_SKIP() << "no address space for the mosaic";
+
+  const int size = 64;
+  const ImageView mosaic = make_view((uint8_t *)mapping, geom);
+  const ImageView tile =
+      mosaic.subview(geom.rows - size, geom.cols - size, size, size);
+  ASSERT_GT((size_t)(tile.data - mosaic.data),
+            (size_t)std::numeric_limits<int32_t>::max());
+  Image expected = {std::vector<uint8_t>(size * size * 4),
+                    ImgGeom{size, size, 4}};
+  for (int y = 0; y < size; ++y)
+    for (int x = 0; x < size * 4; ++x) {
+      const uint8_t sample = (y * 31 + x * 7 + x * x / 5) % 256;
+      tile.data[y * tile.row_stride + x] = sample;
+      expected.data[y * size * 4 + x] = sample;
+    }
+  gaussianblur::gaussianblur(expected, 3.0F, true);
+  gaussianblur::gaussianblur(tile, 3.0F, true);
+  for (int y = 0; y < size; ++y)
+    ASSERT_TRUE(std::equal(expected.data.begin() + y * size * 4,
+                           expected.data.begin() + (y + 1) * size * 4,
+                           tile.data + y * tile.row_stride))
+        << "row " << y;
+
+  // 8 rows of 8 floats, the last one 2.45 G floats past the first
+  const size_t stride = 350000000;
+  float *const rows = (float *)mapping;
+  ASSERT_GT(7 * stride, (size_t)std::numeric_limits<int32_t>::max());
+  for (int y = 0; y < 8; ++y)
+    for (int x = 0; x < 8; ++x) rows[y * stride + x] = (float)(y * 8 + x);
+  for (const auto level :
+       {gaussianblur::IsaLevel::Baseline, gaussianblur::IsaLevel::SSE41,
+        gaussianblur::IsaLevel::AVX2, gaussianblur::IsaLevel::AVX512}) {
+    const gaussianblur::KernelTable *kernels = gaussianblur::kernels_for(level);
+    if (!kernels || kernels->transpose_tile_32 == 0) continue;
+    AlignedVector<float> transposed(64, -1.0F);
+    kernels->transpose_tiles_32(rows, stride, transposed.data(), 8, 8, 8,
+                                false);
+    for (int y = 0; y < 8; ++y)
+      for (int x = 0; x < 8; ++x)
+        ASSERT_EQ(transposed[x * 8 + y], (float)(y * 8 + x));
+  }
+  munmap(mapping, bytes);
+}
+#endif
+
+// Test case for the block sizes derived from the cache sizes
+TEST(HelpersTest, CacheBlockSizes) {
+  ASSERT_EQ(parse_cache_size("48K\n"), 48 * 1024);
+  ASSERT_EQ(parse_cache_size("32M"), 32 * 1024 * 1024);
+  ASSERT_EQ(parse_cache_size("512"), 512);
+  ASSERT_EQ(parse_cache_size("K"), 0);
+
+  const CacheSizes &sizes = cache_sizes();
+  ASSERT_GT(sizes.l1, 0);
+  ASSERT_GE(sizes.l2, sizes.l1);
+
+  // a block and its transposed copy fit the L2, and every thread has one
+  const size_t threads = hybrid_loop_threads();
+  const int block = transpose_block_size(4096, 4096, sizeof(float));
+  ASSERT_EQ(block % 16, 0);
+  ASSERT_LE(2 * (size_t)block * block * sizeof(float),
+            std::max<size_t>(sizes.l2, 2 * 16 * 16 * sizeof(float)));
+  const size_t side_blocks = (4096 + block - 1) / block;
+  ASSERT_TRUE(side_blocks * side_blocks >= threads || block == 16);
+
+  const size_t total = 4096 * 4096;
+  const size_t pixels = interleave_block_size(total, 4 * (1 + sizeof(float)));
+  ASSERT_LE(pixels * 4 * (1 + sizeof(float)),
+            std::max<size_t>(sizes.l2, 64 * 4 * (1 + sizeof(float))));
+  ASSERT_GE(partition_blocks(total, pixels).count, threads);
+  // tiny images are still split among the threads
+  ASSERT_GE(partition_blocks(1000, interleave_block_size(1000, 4)).count,
+            std::min<size_t>(threads, 1000 / 64));
+}
+
+// Test case for the sRGB transfer block hooks
+TEST(HelpersTest, SrgbRoundTrip) {
+  std::vector<float> values(256);
+  for (int i = 0; i < 256; ++i) values[i] = (float)i;
+  float *planes[1] = {values.data()};
+
+  SrgbToLinear<1>{255.0F, true}(planes, 256);
+  for (int i = 0; i < 256; ++i)
+    ASSERT_NEAR(values[i], srgb_to_linear(i / 255.0F) * 255.0F, 1e-3F);
+
+  LinearToSrgb<1>{255.0F, true}(planes, 256);
+  for (int i = 0; i < 256; ++i) ASSERT_EQ(std::lround(values[i]), i);
+}
+
 // Test case for flip_block
 TEST(HelpersTest, FlipBlock) {
   // Create a simple 2x2 block
@@ -218,6 +904,530 @@ TEST(HelpersTest, FlipBlock) {
   ASSERT_EQ(output, expected_output);
 }
 
+// Reference transposition of a w x h image of C channels
+template <int C, typename T>
+std::vector<T> naive_transpose(const std::vector<T> &in, const int w,
+                               const int h) {
+  std::vector<T> out(in.size());
+  for (int y = 0; y < h; ++y)
+    for (int x = 0; x < w; ++x)
+      for (int k = 0; k < C; ++k)
+        out[((size_t)x * h + y) * C + k] = in[((size_t)y * w + x) * C + k];
+  return out;
+}
+
+// Test case for the SIMD tiles of flip_block, with sizes out of the tiles
+TEST(HelpersTest, FlipBlockTiles) {
+  for (const auto &[w, h] : std::vector<std::pair<int, int>>{
+           {1, 1}, {8, 8}, {13, 7}, {64, 48}, {333, 129}}) {
+    std::vector<float> plane((size_t)w * h);
+    for (size_t i = 0; i < plane.size(); ++i) plane[i] = (float)i;
+    std::vector<float> transposed(plane.size());
+    flip_block<1>(plane.data(), transposed.data(), w, h);
+    ASSERT_EQ(transposed, naive_transpose<1>(plane, w, h));
+
+    std::vector<uint8_t> rgba((size_t)w * h * 4), rgb((size_t)w * h * 3);
+    for (size_t i = 0; i < rgba.size(); ++i) rgba[i] = (i * 7) % 256;
+    for (size_t i = 0; i < rgb.size(); ++i) rgb[i] = (i * 5) % 256;
+    std::vector<uint8_t> rgba_t(rgba.size()), rgb_t(rgb.size());
+    flip_block<4>(rgba.data(), rgba_t.data(), w, h);
+    flip_block<3>(rgb.data(), rgb_t.data(), w, h);
+    ASSERT_EQ(rgba_t, naive_transpose<4>(rgba, w, h));
+    ASSERT_EQ(rgb_t, naive_transpose<3>(rgb, w, h));
+
+    std::vector<uint16_t> half(plane.size());
+    for (size_t i = 0; i < half.size(); ++i) half[i] = (uint16_t)(i * 3);
+    std::vector<uint16_t> half_t(half.size());
+    flip_block<1>(half.data(), half_t.data(), w, h);
+    ASSERT_EQ(half_t, naive_transpose<1>(half, w, h));
+  }
+}
+
+// Test case for the kernels of every instruction set level of the CPU, that
+// must give the same results
+TEST(HelpersTest, KernelLevels) {
+  const gaussianblur::KernelTable &selected = gaussianblur::kernels();
+  ASSERT_EQ(gaussianblur::kernels_for(selected.level), &selected);
+  ASSERT_NE(gaussianblur::kernels_for(gaussianblur::IsaLevel::Baseline),
+            nullptr);
+  ASSERT_STREQ(gaussianblur::isa_name(gaussianblur::IsaLevel::AVX2), "avx2");
+
+  const int w = 64, h = 48;
+  AlignedVector<float> plane(w * h), spectrum(w * h), kernel(w * h);
+  for (int i = 0; i < w * h; ++i) {
+    plane[i] = (float)i;
+    spectrum[i] = std::sin((float)i);
+    kernel[i] = std::cos((float)i);
+  }
+  std::vector<uint8_t> rgba(w * h * 4);
+  for (size_t i = 0; i < rgba.size(); ++i) rgba[i] = (i * 13) % 256;
+
+  for (const auto level :
+       {gaussianblur::IsaLevel::Baseline, gaussianblur::IsaLevel::SSE41,
+        gaussianblur::IsaLevel::AVX2, gaussianblur::IsaLevel::AVX512}) {
+    const gaussianblur::KernelTable *kernels = gaussianblur::kernels_for(level);
+    if (!kernels) continue;
+    ASSERT_EQ(kernels->level, level);
+
+    // whole tiles only, written with non-temporal stores when available
+    AlignedVector<float> transposed(w * h, -1.0F);
+    kernels->transpose_tiles_32(plane.data(), w, transposed.data(), h, w, h,
+                                kernels->transpose_tile_32 > 0);
+    if (kernels->transpose_tile_32 > 0) {
+      for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x)
+          ASSERT_EQ(transposed[x * h + y], plane[y * w + x]);
+    }
+
+    std::vector<float> r(w * h), g(w * h), b(w * h), a(w * h);
+    float *planes[4] = {r.data(), g.data(), b.data(), a.data()};
+    const int split = kernels->deinterleave_rgba8(rgba.data(), planes, w * h);
+    for (int x = 0; x < split; ++x)
+      ASSERT_EQ(planes[x % 4][x], rgba[x * 4 + x % 4]);
+    std::vector<uint8_t> merged(rgba.size());
+    const int merged_pixels =
+        kernels->interleave_rgba8(planes, merged.data(), split);
+    ASSERT_TRUE(std::equal(merged.begin(), merged.begin() + merged_pixels * 4,
+                           rgba.begin()));
+    std::vector<uint8_t> rgb(w * h * 3), rgb_merged(rgb.size());
+    for (size_t i = 0; i < rgb.size(); ++i) rgb[i] = (i * 7) % 256;
+    const int rgb_split = kernels->deinterleave_rgb8(rgb.data(), planes, w * h);
+    for (int x = 0; x < rgb_split * 3; ++x)
+      ASSERT_EQ(planes[x % 3][x / 3], rgb[x]);
+    const int rgb_merged_pixels =
+        kernels->interleave_rgb8(planes, rgb_merged.data(), rgb_split);
+    ASSERT_TRUE(std::equal(rgb_merged.begin(),
+                           rgb_merged.begin() + rgb_merged_pixels * 3,
+                           rgb.begin()));
+    // the byte shuffles run from SSE4.1 on, all but a tail of a few pixels
+    if (level >= gaussianblur::IsaLevel::SSE41) {
+      ASSERT_GE(split, w * h - 8);
+      ASSERT_GE(merged_pixels, split - 8);
+      ASSERT_GE(rgb_split, w * h - 8);
+      ASSERT_GE(rgb_merged_pixels, rgb_split - 8);
+    }
+
+    AlignedVector<float> product = spectrum;
+    kernels->spectral_multiply(product.data(), kernel.data(), product.size(),
+                               0.5F);
+    for (size_t i = 0; i < product.size(); ++i)
+      ASSERT_EQ(product[i],
+                spectrum[i] * (kernel[i == 1 ? 1 : i & ~(size_t)1] * 0.5F));
+
+    // binary16 conversions as the scalar ones, from the subnormals to the
+    // overflows, the F16C levels convert in SIMD registers
+    std::vector<float> values(w * h), widened(w * h);
+    std::vector<uint16_t> halves(w * h);
+    for (size_t i = 0; i < values.size(); ++i)
+      values[i] = std::ldexp(spectrum[i], (int)(i % 48) - 30);
+    const size_t narrowed =
+        kernels->float_to_half(values.data(), halves.data(), halves.size());
+    for (size_t i = 0; i < narrowed; ++i)
+      ASSERT_EQ(halves[i], float_to_half_bits(values[i]));
+    const size_t widened_count =
+        kernels->half_to_float(halves.data(), widened.data(), narrowed);
+    for (size_t i = 0; i < widened_count; ++i)
+      ASSERT_EQ(widened[i], half_bits_to_float(halves[i]));
+    if (level >= gaussianblur::IsaLevel::AVX2) {
+      ASSERT_EQ(narrowed, halves.size());
+      ASSERT_EQ(widened_count, halves.size());
+    }
+  }
+}
+
+// Test case for the batched FFT of every level against a naive DFT in the
+// order of pffft_transform_ordered, over the radix 2, 3, 4 and 5 passes, whole
+// and pruned to trailing zeros and to a window of the backward transform
+TEST(HelpersTest, BatchedFft) {
+  for (const auto level :
+       {gaussianblur::IsaLevel::Baseline, gaussianblur::IsaLevel::SSE41,
+        gaussianblur::IsaLevel::AVX2, gaussianblur::IsaLevel::AVX512}) {
+    const gaussianblur::KernelTable *kernels = gaussianblur::kernels_for(level);
+    if (!kernels) continue;
+    const int batch = kernels->fft_batch;
+
+    for (const auto &[n, pruned] :
+         {std::pair{32, false}, {64, false}, {96, false}, {160, false},
+          {480, false}, {64, true}, {160, true}, {480, true}}) {
+      const BatchedFftSetup setup(n);
+      // nonzero samples and samples computed by the backward transform
+      const int nonzero = pruned ? n * 5 / 8 + 1 : n;
+      const int first = pruned ? n / 3 : 0, last = pruned ? first + n / 5 : n;
+      AlignedVector<float> rows(n * batch), spectra(n * batch),
+          back(n * batch), work(n * batch);
+      for (size_t i = 0; i < rows.size(); ++i)
+        rows[i] = i / batch < (size_t)nonzero
+                      ? std::sin(i * 0.37F) + (i % 7) * 0.25F
+                      : 0.0F;
+      kernels->batched_fft(setup.plan(), rows.data(), spectra.data(),
+                           work.data(), true, 0, nonzero);
+
+      for (int l = 0; l < batch; ++l) {
+        std::vector<double> expected(n);
+        for (int k = 0; k <= n / 2; ++k) {
+          double re = 0, im = 0;
+          for (int t = 0; t < n; ++t) {
+            const double angle = -2 * std::numbers::pi * k * t / n;
+            re += rows[t * batch + l] * std::cos(angle);
+            im += rows[t * batch + l] * std::sin(angle);
+          }
+          if (k == 0)
+            expected[0] = re;
+          else if (k == n / 2)
+            expected[1] = re;
+          else {
+            expected[2 * k] = re;
+            expected[2 * k + 1] = im;
+          }
+        }
+        for (int i = 0; i < n; ++i)
+          ASSERT_NEAR(spectra[i * batch + l], expected[i], 1e-3 * n)
+              << "size " << n << " bin " << i;
+      }
+
+      kernels->batched_fft(setup.plan(), spectra.data(), back.data(),
+                           work.data(), false, first, last);
+      for (size_t i = (size_t)first * batch; i < (size_t)last * batch; ++i)
+        ASSERT_NEAR(back[i] / n, rows[i], 1e-4);
+    }
+  }
+}
+
+// Test case for the FFT backends: valid sizes, round trips and blurs that
+// match whatever the backend
+TEST(GaussianBlurTest, FftBackends) {
+  const gaussianblur::FftBackend &pffft = gaussianblur::pffft_backend();
+  const gaussianblur::FftBackend &batched = gaussianblur::batched_fft_backend();
+  ASSERT_TRUE(pffft.is_valid_size(480));
+  ASSERT_FALSE(pffft.is_valid_size(54));
+  ASSERT_EQ(pffft.nearest_valid_size(33), 64);
+  ASSERT_TRUE(batched.is_valid_size(54));
+  ASSERT_EQ(batched.nearest_valid_size(51), 54);
+  ASSERT_EQ(batched.setup(14), nullptr);
+
+  const ImgGeom geom = {37, 53, 3};
+  std::vector<uint8_t> image_data((size_t)geom.rows * geom.cols * 3);
+  for (size_t i = 0; i < image_data.size(); ++i)
+    image_data[i] = (i * 2654435761U >> 13) % 256;
+
+  std::vector<std::vector<uint8_t>> blurred;
+  for (const gaussianblur::FftBackend *backend : {&pffft, &batched}) {
+    for (const int n : {64, 54}) {
+      std::unique_ptr<gaussianblur::FftSetup> setup = backend->setup(n);
+      if (!setup) continue;
+      // the last row of a pass through the fewest lanes available
+      ASSERT_EQ(setup->narrowed(setup->layout().batch), nullptr);
+      const std::unique_ptr<gaussianblur::FftSetup> narrowed =
+          setup->narrowed(1);
+      if (narrowed) {
+        ASSERT_EQ(narrowed->size(), n);
+        ASSERT_LT(narrowed->layout().batch, setup->layout().batch);
+      }
+      for (const gaussianblur::FftSetup *lanes :
+           {setup.get(), narrowed.get()}) {
+        if (!lanes) continue;
+        const size_t floats = (size_t)n * lanes->layout().batch;
+        AlignedVector<float> signal(floats), spectrum(floats), back(floats),
+            work(floats);
+        for (size_t i = 0; i < floats; ++i) signal[i] = std::cos(i * 0.1F);
+        lanes->forward(signal.data(), spectrum.data(), work.data());
+        lanes->backward(spectrum.data(), back.data(), work.data());
+        for (size_t i = 0; i < floats; ++i)
+          ASSERT_NEAR(back[i] / n, signal[i], 1e-4) << backend->name();
+      }
+    }
+
+    gaussianblur::BlurOptions options;
+    options.fft_backend = backend;
+    std::vector<uint8_t> result(image_data.size());
+    gaussianblur::gaussianblur(make_view(image_data.data(), geom),
+                               make_view(result.data(), geom), 4.0F, options);
+    blurred.push_back(std::move(result));
+  }
+  for (size_t i = 0; i < image_data.size(); ++i)
+    ASSERT_NEAR(blurred[0][i], blurred[1][i], 1);
+}
+
+// Test case for narrow images, whose short rows and columns are packed end to
+// end in shared transforms, against a direct convolution
+TEST(GaussianBlurTest, PackedNarrowTiles) {
+  for (const auto &[rows, cols] : {std::pair{70, 20}, {9, 300}, {24, 24}}) {
+    ImageF32 image = {std::vector<float>((size_t)rows * cols),
+                      ImgGeom{rows, cols, 1}};
+    for (int y = 0; y < rows; ++y)
+      for (int x = 0; x < cols; ++x)
+        image.data[y * cols + x] =
+            0.5F + 0.3F * std::sin(x * 0.3F) * std::cos(y * 0.2F);
+    const std::vector<double> expected =
+        reference_blur(image.data, rows, cols, 2.0F, 1.0F / 65535);
+
+    for (const gaussianblur::FftBackend *backend :
+         {&gaussianblur::pffft_backend(),
+          &gaussianblur::batched_fft_backend()}) {
+      ImageF32 blurred = image;
+      gaussianblur::BlurOptions options;
+      options.fft_backend = backend;
+      gaussianblur::gaussianblur(blurred, 2.0F, options);
+      for (size_t i = 0; i < expected.size(); ++i)
+        ASSERT_NEAR(blurred.data[i], expected[i], 1e-4)
+            << backend->name() << " " << rows << "x" << cols << " sample "
+            << i;
+    }
+  }
+}
+
+// Test case for the four-step FFT against pffft, with square and oblong
+// matrices of the complex points
+TEST(HelpersTest, FourStepFft) {
+  const gaussianblur::FftBackend &four_step =
+      gaussianblur::four_step_fft_backend();
+  ASSERT_TRUE(four_step.is_valid_size(1536));
+  ASSERT_FALSE(four_step.is_valid_size(1024 + 32));
+  ASSERT_EQ(four_step.nearest_valid_size(700), 1024);
+  for (const int n : {512, 1536, 5120}) {
+    AlignedVector<float> signal(n), spectrum(n), expected(n), round_trip(n),
+        work(n);
+    for (int i = 0; i < n; ++i)
+      signal[i] = std::sin(i * 0.05F) + (i % 7) * 0.1F;
+    gaussianblur::pffft_backend().setup(n)->forward(
+        signal.data(), expected.data(), work.data());
+
+    const auto setup = four_step.setup(n);
+    setup->forward(signal.data(), spectrum.data(), work.data());
+    for (int i = 0; i < n; ++i)
+      ASSERT_NEAR(spectrum[i], expected[i], 1e-3 * n) << n << " bin " << i;
+    setup->backward(spectrum.data(), round_trip.data(), work.data());
+    for (int i = 0; i < n; ++i)
+      ASSERT_NEAR(round_trip[i] / n, signal[i], 1e-4) << n << " sample " << i;
+  }
+}
+
+// Test case for rows narrower than the pads, which are reflected back and
+// forth, for the long rows of the four-step FFT and for a last group of a
+// single row past the full ones
+TEST(GaussianBlurTest, FewLongRows) {
+  const int lanes = gaussianblur::kernels().fft_batch;
+  for (const auto &[rows, cols] :
+       {std::pair{1, 300}, {3, 2000}, {lanes + 1, 300}}) {
+    ImageF32 image = {std::vector<float>((size_t)rows * cols),
+                      ImgGeom{rows, cols, 1}};
+    for (int y = 0; y < rows; ++y)
+      for (int x = 0; x < cols; ++x)
+        image.data[y * cols + x] =
+            0.5F + 0.3F * std::sin(x * 0.05F) * std::cos(y * 0.7F);
+    const std::vector<double> expected =
+        reference_blur(image.data, rows, cols, 2.0F, 1.0F / 65535);
+
+    for (const gaussianblur::FftBackend *backend :
+         {&gaussianblur::default_fft_backend(),
+          &gaussianblur::four_step_fft_backend()}) {
+      ImageF32 blurred = image;
+      gaussianblur::BlurOptions options;
+      options.fft_backend = backend;
+      gaussianblur::gaussianblur(blurred, 2.0F, options);
+      for (size_t i = 0; i < expected.size(); ++i)
+        ASSERT_NEAR(blurred.data[i], expected[i], 1e-4)
+            << backend->name() << " " << rows << "x" << cols << " sample "
+            << i;
+    }
+  }
+}
+
+// Test case for the truncation of the kernel: the pads shrink as it rises and
+// the error against the Gaussian truncated far in its tails follows it
+TEST(GaussianBlurTest, KernelTruncation) {
+  const ImgGeom geom = {64, 64, 1};
+  const int pad_16 =
+      gaussianblur::prepare_kernel_DFT(geom, 3.0F,
+                                       gaussianblur::default_fft_backend(),
+                                       1.0F / 16)
+          .pad;
+  const int pad_255 = gaussianblur::prepare_kernel_DFT(geom, 3.0F).pad;
+  ASSERT_LT(pad_16, pad_255);
+
+  ImageF32 image = {std::vector<float>(64 * 64), geom};
+  std::mt19937 gen(3);
+  std::uniform_real_distribution<float> dis(0.0F, 1.0F);
+  for (float &sample : image.data) sample = dis(gen);
+  const std::vector<double> exact =
+      reference_blur(image.data, 64, 64, 3.0F, 1e-9F);
+  double previous_error = 1;
+  for (const float truncation : {1.0F / 16, 1.0F / 255, 1.0F / 65535}) {
+    ImageF32 blurred = image;
+    gaussianblur::BlurOptions options;
+    options.truncation = truncation;
+    gaussianblur::gaussianblur(blurred, 3.0F, options);
+    double max_error = 0;
+    for (size_t i = 0; i < exact.size(); ++i)
+      max_error = std::max(max_error, std::abs(blurred.data[i] - exact[i]));
+    ASSERT_LT(max_error, truncation / 2) << truncation;
+    ASSERT_LT(max_error, previous_error) << truncation;
+    previous_error = max_error;
+  }
+}
+
+// Test case for truncations out of [0, 1], which leave the images unchanged
+TEST(GaussianBlurTest, InvalidTruncation) {
+  const ImgGeom geom = {16, 16, 1}, half_geom = {8, 8, 1};
+  std::vector<uint8_t> image_data(16 * 16);
+  for (size_t i = 0; i < image_data.size(); ++i)
+    image_data[i] = (i * 37) % 256;
+  const std::vector<uint8_t> untouched(8 * 8, 7);
+
+  for (const float truncation :
+       {-0.5F, 1.5F, std::numeric_limits<float>::quiet_NaN()}) {
+    gaussianblur::BlurOptions options;
+    options.truncation = truncation;
+    Image image = {image_data, geom};
+    gaussianblur::gaussianblur(image, 2.0F, options);
+    ASSERT_EQ(image.data, image_data) << truncation;
+
+    std::vector<uint8_t> downscaled = untouched;
+    gaussianblur::gaussianblur_downscale(
+        make_view(image_data.data(), geom),
+        make_view(downscaled.data(), half_geom), 2.0F, 2, options);
+    ASSERT_EQ(downscaled, untouched) << truncation;
+  }
+
+  // the loosest truncation keeps the center sample only
+  gaussianblur::BlurOptions options;
+  options.truncation = 1;
+  Image image = {image_data, geom};
+  gaussianblur::gaussianblur(image, 2.0F, options);
+  ASSERT_EQ(image.data, image_data);
+}
+
+// Test case for the blur fused with the decimation: every factor-th pixel of
+// the full blur, the alpha that is not blurred being decimated alone
+TEST(GaussianBlurTest, DownscaleBlur) {
+  const int rows = 61, cols = 47;
+  const ImgGeom geom = {rows, cols, 4};
+  std::vector<uint8_t> rgba((size_t)rows * cols * 4);
+  std::mt19937 gen(5);
+  std::uniform_int_distribution<> dis(0, 255);
+  for (auto &sample : rgba) sample = dis(gen);
+  std::vector<uint8_t> full = rgba;
+  gaussianblur::gaussianblur(make_view(full.data(), geom), 2.0F,
+                             gaussianblur::BlurOptions{});
+
+  for (const int factor : {1, 3, 4}) {
+    const ImgGeom small_geom = {(rows + factor - 1) / factor,
+                                (cols + factor - 1) / factor, 4};
+    std::vector<uint8_t> small((size_t)small_geom.rows * small_geom.cols * 4);
+    gaussianblur::gaussianblur_downscale(
+        make_view(rgba.data(), geom), make_view(small.data(), small_geom),
+        2.0F, factor, gaussianblur::BlurOptions{});
+    for (int y = 0; y < small_geom.rows; ++y)
+      for (int x = 0; x < small_geom.cols; ++x)
+        for (int c = 0; c < 4; ++c) {
+          const size_t i = ((size_t)y * small_geom.cols + x) * 4 + c,
+                       source =
+                           ((size_t)y * factor * cols + x * factor) * 4 + c;
+          if (c == 3)
+            ASSERT_EQ(small[i], rgba[source]);
+          else
+            ASSERT_NEAR(small[i], full[source], 1) << factor << " " << i;
+        }
+  }
+
+  // 16-bit samples, alpha included, and the red and alpha channels only of
+  // the 8-bit image against their full blur decimated afterwards
+  std::vector<uint16_t> rgba16(rgba.size());
+  for (size_t i = 0; i < rgba.size(); ++i) rgba16[i] = rgba[i] * 257 + i % 257;
+  gaussianblur::BlurOptions options16, masked;
+  options16.apply_to_alpha = true;
+  masked.channel_mask = 1U << 0 | 1U << 3;
+  std::vector<uint16_t> full16 = rgba16;
+  gaussianblur::gaussianblur(make_view(full16.data(), geom), 2.0F, options16);
+  std::vector<uint8_t> full_masked = rgba;
+  gaussianblur::gaussianblur(make_view(full_masked.data(), geom), 2.0F, masked);
+  for (const int factor : {2, 3}) {
+    const ImgGeom small_geom = {(rows + factor - 1) / factor,
+                                (cols + factor - 1) / factor, 4};
+    const size_t small_size = (size_t)small_geom.rows * small_geom.cols * 4;
+    std::vector<uint16_t> small16(small_size);
+    gaussianblur::gaussianblur_downscale(
+        make_view(rgba16.data(), geom), make_view(small16.data(), small_geom),
+        2.0F, factor, options16);
+    std::vector<uint8_t> small_masked(small_size);
+    gaussianblur::gaussianblur_downscale(
+        make_view(rgba.data(), geom),
+        make_view(small_masked.data(), small_geom), 2.0F, factor, masked);
+    for (int y = 0; y < small_geom.rows; ++y)
+      for (int x = 0; x < small_geom.cols; ++x)
+        for (int c = 0; c < 4; ++c) {
+          const size_t i = ((size_t)y * small_geom.cols + x) * 4 + c,
+                       source =
+                           ((size_t)y * factor * cols + x * factor) * 4 + c;
+          ASSERT_NEAR(small16[i], full16[source], 1) << factor << " " << i;
+          ASSERT_NEAR(small_masked[i], full_masked[source], 1)
+              << factor << " " << i;
+          // the channels out of the mask are subsampled only
+          if (c == 1 || c == 2) {
+            ASSERT_EQ(small_masked[i], rgba[source]);
+          }
+        }
+  }
+
+  ImageF32 plane = {std::vector<float>((size_t)rows * cols),
+                    ImgGeom{rows, cols, 1}};
+  for (int y = 0; y < rows; ++y)
+    for (int x = 0; x < cols; ++x)
+      plane.data[y * cols + x] = 0.5F + 0.3F * std::sin(x * 0.4F + y * 0.3F);
+  const std::vector<double> expected =
+      reference_blur(plane.data, rows, cols, 3.0F, 1.0F / 65535);
+  const ImgGeom small_geom = {(rows + 4) / 5, (cols + 4) / 5, 1};
+  std::vector<float> small((size_t)small_geom.rows * small_geom.cols);
+  gaussianblur::gaussianblur_downscale(
+      make_view(plane.data.data(), plane.geom),
+      make_view(small.data(), small_geom), 3.0F, 5,
+      gaussianblur::BlurOptions{});
+  for (int y = 0; y < small_geom.rows; ++y)
+    for (int x = 0; x < small_geom.cols; ++x)
+      ASSERT_NEAR(small[y * small_geom.cols + x],
+                  expected[(size_t)y * 5 * cols + x * 5], 1e-4);
+}
+
+// Test case for the SIMD (de)interleave of 8-bit RGB/RGBA pixels, with
+// lengths out of the vectors and samples out of the 8-bit range
+template <uint32_t Channels>
+void check_u8_interleave(const int pixels) {
+  std::vector<uint8_t> interleaved((size_t)pixels * Channels);
+  for (size_t i = 0; i < interleaved.size(); ++i)
+    interleaved[i] = (i * 37 + i / 7) % 256;
+  std::vector<std::vector<float>> planes(Channels,
+                                         std::vector<float>(pixels));
+  float *plane_ptrs[Channels];
+  for (uint32_t c = 0; c < Channels; ++c) plane_ptrs[c] = planes[c].data();
+
+  deinterleave_channels<Channels>(interleaved.data(), plane_ptrs, pixels);
+  for (int x = 0; x < pixels; ++x)
+    for (uint32_t c = 0; c < Channels; ++c)
+      ASSERT_EQ(planes[c][x], interleaved[x * Channels + c]);
+
+  const float overshoots[] = {-10.0F, -0.4F, 127.5F, 254.6F, 255.4F, 300.0F};
+  for (int x = 0; x < pixels; ++x)
+    planes[x % Channels][x] = overshoots[x % 6];
+  std::vector<uint8_t> result(interleaved.size());
+  interleave_channels<Channels>(plane_ptrs, result.data(), pixels);
+  for (int x = 0; x < pixels; ++x)
+    for (uint32_t c = 0; c < Channels; ++c)
+      ASSERT_EQ(result[x * Channels + c],
+                convert_sample<uint8_t>(planes[c][x]));
+}
+
+TEST(HelpersTest, SaturatingInterleave) {
+  ASSERT_EQ(convert_sample<uint8_t>(-3.0F), 0);
+  ASSERT_EQ(convert_sample<uint8_t>(255.7F), 255);
+  ASSERT_EQ(convert_sample<uint8_t>(127.5F), 128);
+  ASSERT_EQ(convert_sample<uint16_t>(70000.0F), 65535);
+  ASSERT_EQ(convert_sample<float>(uint8_t(200)), 200.0F);
+  for (const int pixels : {1, 3, 4, 5, 8, 15, 16, 17, 61}) {
+    check_u8_interleave<3>(pixels);
+    check_u8_interleave<4>(pixels);
+  }
+}
+
 // Test case for deinterleave_channels
 TEST(HelpersTest, DeinterleaveChannels) {
   // Create a 3x3 RGB image
@@ -244,6 +1454,29 @@ TEST(HelpersTest, DeinterleaveChannels) {
   ASSERT_EQ(blue, expected_blue);
 }
 
+// Test case for deinterleave_channels and interleave_channels with a runtime
+// number of channels
+TEST(HelpersTest, RuntimeChannels) {
+  const uint32_t channels = 5, size = 3;
+  std::vector<uint8_t> interleaved(channels * size);
+  std::iota(interleaved.begin(), interleaved.end(), 0);
+
+  std::vector<std::vector<float>> planes(channels, std::vector<float>(size));
+  std::vector<float*> planes_ptr;
+  for (auto& plane : planes) planes_ptr.push_back(plane.data());
+  deinterleave_channels(interleaved.data(), planes_ptr.data(), size, channels);
+  for (uint32_t c = 0; c < channels; ++c)
+    for (uint32_t i = 0; i < size; ++i)
+      ASSERT_EQ(planes[c][i], interleaved[i * channels + c]);
+
+  std::vector<uint8_t> round_trip(channels * size);
+  std::vector<const float*> const_planes_ptr(planes_ptr.begin(),
+                                             planes_ptr.end());
+  interleave_channels(const_planes_ptr.data(), round_trip.data(), size,
+                      channels);
+  ASSERT_EQ(round_trip, interleaved);
+}
+
 // Test case for interleave_channels
 TEST(HelpersTest, InterleaveChannels) {
   // Create separate channels for a 3x3 RGB image
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
 #include <vector>
 
@@ -19,4 +21,41 @@ float calculate_variance(const std::vector<uint8_t>& data, float mean) {
     variance += (value - mean) * (value - mean);
   }
   return variance / data.size();
-}
\ No newline at end of file
+}
+
+// Helper function to blur a gray plane by direct convolution with the
+// Gaussian of the library truncated at `truncation` times its peak,
+// reflecting the borders
+std::vector<double> reference_blur(const std::vector<float>& plane,
+                                   const int rows, const int cols,
+                                   const float sigma,
+                                   const float truncation = 1.0F / 255) {
+  const double radius =
+      std::max(sigma * std::sqrt(2 * std::log(1.0 / truncation)) - 1, 0.0);
+  int width = std::min((int)(radius * 2 + 0.5F), std::max(rows, cols));
+  if (width % 2 == 0) ++width;
+  const int pad = width / 2;
+  std::vector<double> kernel(width);
+  double sum = 0;
+  for (int i = 0; i < width; ++i)
+    sum += kernel[i] = std::exp(-(i - pad) * (i - pad) / (2.0 * sigma * sigma));
+  for (double& k : kernel) k /= sum;
+
+  auto reflect = [](int i, const int size) {
+    if (size == 1) return 0;
+    while (i < 0 || i >= size) i = i < 0 ? -i : 2 * (size - 1) - i;
+    return i;
+  };
+  std::vector<double> horizontal(plane.size()), result(plane.size());
+  for (int y = 0; y < rows; ++y)
+    for (int x = 0; x < cols; ++x)
+      for (int i = 0; i < width; ++i)
+        horizontal[y * cols + x] +=
+            kernel[i] * plane[y * cols + reflect(x + i - pad, cols)];
+  for (int y = 0; y < rows; ++y)
+    for (int x = 0; x < cols; ++x)
+      for (int i = 0; i < width; ++i)
+        result[y * cols + x] +=
+            kernel[i] * horizontal[reflect(y + i - pad, rows) * cols + x];
+  return result;
+}